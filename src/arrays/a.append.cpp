@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <m_pd.h>
-#include <string>
+
+#include "xlab-array.hpp"
 
 #define NEIMOG_MAXARRAYSIZE 10000000
+#define NEIMOG_MINCAPACITY 64
 
 static t_class *neimog_arrayappend;
 
@@ -9,77 +12,93 @@ static t_class *neimog_arrayappend;
 class arrayappend {
   public:
     t_object obj;
-    std::string arrayname;
+    xlab_array arr;
     int index;
-    int arraysize;
-    int resize_step;
+    bool unsaved;
 };
 
 // ─────────────────────────────────────
-static void arrayappend_float(arrayappend *x, t_float f) {
-    t_garray *array;
-    int vecsize;
-    t_word *vec;
+static bool arrayappend_bind(arrayappend *x) {
+    if (!x->arr.get(x, "a.append")) {
+        return false;
+    }
+    // the contents are rebuilt at run time, don't store them in the patch
+    if (!x->unsaved) {
+        garray_setsaveit(x->arr.array, 0);
+        x->unsaved = true;
+    }
+    // the array size is the capacity, someone else may have shrunk it
+    x->index = std::min(x->index, x->arr.size);
+    return true;
+}
 
-    t_symbol *pd_symbol = gensym(x->arrayname.c_str());
+// ─────────────────────────────────────
+static bool arrayappend_reserve(arrayappend *x, int n) {
+    if (x->index + n <= x->arr.size) {
+        return true;
+    }
+    if (x->index + n > NEIMOG_MAXARRAYSIZE) {
+        pd_error(x, "[a.append] Array too big.");
+        return false;
+    }
 
-    if (!(array = (t_garray *)pd_findbyclass(pd_symbol, garray_class))) {
-        pd_error(x, "[a.append] Array %s not found.", x->arrayname.c_str());
-        return;
-    } else if (!garray_getfloatwords(array, &vecsize, &vec)) {
-        pd_error(x, "[a.append] Bad template for tabwrite '%s'.", x->arrayname.c_str());
-        return;
+    // geometric growth, so appending is O(1) amortized
+    int capacity = std::max(x->arr.size * 2, NEIMOG_MINCAPACITY);
+    capacity = std::max(capacity, x->index + n);
+    capacity = std::min(capacity, NEIMOG_MAXARRAYSIZE);
+    if (!x->arr.resize(x, "a.append", capacity)) {
+        return false;
+    } else if (x->arr.size < x->index + n) {
+        pd_error(x, "[a.append] Failed to resize '%s'.", x->arr.name->s_name);
+        return false;
     }
+    xlab_redraw::request(x->arr);
+    return true;
+}
 
-    x->arraysize = garray_npoints(array);
-    if (x->arraysize + x->resize_step > NEIMOG_MAXARRAYSIZE) {
-        pd_error(x, "[a.append] Array too big.");
-        x->index = 0;
+// ─────────────────────────────────────
+static void arrayappend_float(arrayappend *x, t_float f) {
+    if (!arrayappend_bind(x) || !arrayappend_reserve(x, 1)) {
         return;
     }
+    x->arr.vec[x->index].w_float = f;
+    x->index++;
+}
 
-    if (x->arraysize - 1 < x->index) {
-        pd_error(x, "[a.append] Array too small.");
+// ─────────────────────────────────────
+static void arrayappend_list(arrayappend *x, t_symbol *s, int argc, t_atom *argv) {
+    if (!arrayappend_bind(x) || !arrayappend_reserve(x, argc)) {
         return;
     }
-
-    if (x->arraysize - 1 == x->index) {
-        garray_resize_long(array, x->resize_step + 100);
-        garray_redraw(array);
-        if (!(array = (t_garray *)pd_findbyclass(pd_symbol, garray_class))) {
-            pd_error(x, "[a.append] Array %s not found.", x->arrayname.c_str());
-            return;
-        } else if (!garray_getfloatwords(array, &vecsize, &vec)) {
-            pd_error(x, "[a.append] Bad template for tabwrite '%s'.", x->arrayname.c_str());
-            return;
-        }
-        if (!(array = (t_garray *)pd_findbyclass(pd_symbol, garray_class))) {
-            pd_error(x, "[a.append] a.arrayappend %s not found.", x->arrayname.c_str());
-            return;
-        }
-
-        x->arraysize = garray_npoints(array);
+    t_word *vec = x->arr.vec + x->index;
+    for (int i = 0; i < argc; i++) {
+        vec[i].w_float = atom_getfloat(argv + i);
     }
+    x->index += argc;
+}
 
-    // vec[x->index].w_float = f;
-    x->index++;
+// ─────────────────────────────────────
+static void arrayappend_bang(arrayappend *x) {
+    // shrink the array to the values written so far
+    if (!arrayappend_bind(x)) {
+        return;
+    }
+    if (x->arr.size != x->index && !x->arr.resize(x, "a.append", std::max(x->index, 1))) {
+        return;
+    }
+    xlab_redraw::request(x->arr);
 }
 
+// ─────────────────────────────────────
+static void arrayappend_clear(arrayappend *x) { x->index = 0; }
+
 // ─────────────────────────────────────
 static void *arrayappend_new(t_symbol *s) {
     arrayappend *x = (arrayappend *)pd_new(neimog_arrayappend);
-    t_garray *array;
-    x->arrayname = s->s_name;
+    x->arr.set(s);
     x->index = 0;
-    x->resize_step = 100;
-    if (!(array = (t_garray *)pd_findbyclass(s, garray_class))) {
-        pd_error(x, "[a.append] a.arrayappend %s not found.", x->arrayname.c_str());
-        return NULL;
-    }
-
-    x->arraysize = garray_npoints(array);
-
-    garray_setsaveit(array, 0);
+    x->unsaved = false;
+    // the array may come later in the patch, it is looked up on the first value
     return x;
 }
 
@@ -88,4 +107,7 @@ void arrayappend_setup(void) {
     neimog_arrayappend = class_new(gensym("a.append"), (t_newmethod)arrayappend_new, 0,
                                    sizeof(arrayappend), 0, A_SYMBOL, 0);
     class_addfloat(neimog_arrayappend, (t_method)arrayappend_float);
+    class_addlist(neimog_arrayappend, (t_method)arrayappend_list);
+    class_addbang(neimog_arrayappend, (t_method)arrayappend_bang);
+    class_addmethod(neimog_arrayappend, (t_method)arrayappend_clear, gensym("clear"), A_NULL);
 }
@@ -1,45 +1,220 @@
+#include <algorithm>
 #include <m_pd.h>
+#include <stdint.h>
 #include <string>
 
+#include "xlab-array.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// ╭─────────────────────────────────────╮
+// │  In-place array transforms. With    │
+// │  32-bit floats on 64-bit systems a  │
+// │  t_word is 8 bytes, so the floats   │
+// │  sit in every other 4-byte lane.    │
+// │  The kernels load pairs of words,   │
+// │  pack the floats, transform them    │
+// │  and unpack them back, keeping the  │
+// │  padding lanes untouched.           │
+// ╰─────────────────────────────────────╯
+
+#if PD_FLOATSIZE == 32 && UINTPTR_MAX == 0xffffffffffffffffu
+#define NEIMOG_STRIDED_WORDS 1
+#endif
+
 static t_class *neimog_arrayinvert;
 
 // ─────────────────────────────────────
 class arrayinvert {
   public:
     t_object obj;
-    unsigned sumlast;
-    std::string arrayname;
-    t_outlet *out;
+    xlab_array arr;
 };
 
 // ─────────────────────────────────────
-static void arrayinvert_bang(arrayinvert *x) {
-    t_garray *array;
-    int vecsize;
-    t_word *vec;
+struct invert_negate {
+    static t_float scalar(t_float v) { return -v; }
+#if defined(__AVX__)
+    static __m256 avx(__m256 v) { return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f)); }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    static __m128 sse(__m128 v) { return _mm_xor_ps(v, _mm_set1_ps(-0.0f)); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static float32x4_t neon(float32x4_t v) { return vnegq_f32(v); }
+#endif
+};
 
-    t_symbol *pd_symbol = gensym(x->arrayname.c_str());
-    if (!(array = (t_garray *)pd_findbyclass(pd_symbol, garray_class))) {
-        pd_error(x, "[a.invert] array %s not found.", x->arrayname.c_str());
-        return;
-    } else if (!garray_getfloatwords(array, &vecsize, &vec)) {
-        pd_error(x, "[a.invert] Bad template for tabwrite '%s'.", x->arrayname.c_str());
+// ─────────────────────────────────────
+struct invert_complement {
+    static t_float scalar(t_float v) { return 1 - v; }
+#if defined(__AVX__)
+    static __m256 avx(__m256 v) { return _mm256_sub_ps(_mm256_set1_ps(1.0f), v); }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    static __m128 sse(__m128 v) { return _mm_sub_ps(_mm_set1_ps(1.0f), v); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static float32x4_t neon(float32x4_t v) { return vsubq_f32(vdupq_n_f32(1.0f), v); }
+#endif
+};
+
+// ─────────────────────────────────────
+// 1/x, zeros are kept as zeros instead of becoming inf
+struct invert_reciprocal {
+    static t_float scalar(t_float v) { return v != 0 ? 1 / v : 0; }
+#if defined(__AVX__)
+    static __m256 avx(__m256 v) {
+        __m256 nonzero = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+        return _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), v), nonzero);
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    static __m128 sse(__m128 v) {
+        __m128 nonzero = _mm_cmpneq_ps(v, _mm_setzero_ps());
+        return _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), v), nonzero);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static float32x4_t neon(float32x4_t v) {
+        uint32x4_t zero = vceqq_f32(v, vdupq_n_f32(0.0f));
+        float32x4_t r = vdivq_f32(vdupq_n_f32(1.0f), v);
+        return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(r), zero));
+    }
+#endif
+};
+
+// ─────────────────────────────────────
+template <typename Op> static void arrayinvert_transform(t_word *vec, int n) {
+    int i = 0;
+#if defined(NEIMOG_STRIDED_WORDS)
+    float *f = (float *)vec;
+#if defined(__AVX__)
+    for (; i + 8 <= n; i += 8) {
+        // the in-lane shuffles permute the floats, unpacking applies the inverse permutation
+        __m256 a = _mm256_loadu_ps(f + 2 * i);
+        __m256 b = _mm256_loadu_ps(f + 2 * i + 8);
+        __m256 r = Op::avx(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256 pad = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm256_storeu_ps(f + 2 * i, _mm256_unpacklo_ps(r, pad));
+        _mm256_storeu_ps(f + 2 * i + 8, _mm256_unpackhi_ps(r, pad));
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(f + 2 * i);
+        __m128 b = _mm_loadu_ps(f + 2 * i + 4);
+        __m128 r = Op::sse(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128 pad = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(f + 2 * i, _mm_unpacklo_ps(r, pad));
+        _mm_storeu_ps(f + 2 * i + 4, _mm_unpackhi_ps(r, pad));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v = vld2q_f32(f + 2 * i);
+        v.val[0] = Op::neon(v.val[0]);
+        vst2q_f32(f + 2 * i, v);
+    }
+#endif
+#endif
+    // contiguous t_words (double precision or 32-bit systems) are left to the compiler
+    for (; i < n; i++) {
+        vec[i].w_float = Op::scalar(vec[i].w_float);
+    }
+}
+
+// ─────────────────────────────────────
+static void arrayinvert_reverse(t_word *vec, int n) {
+#if defined(NEIMOG_STRIDED_WORDS) && (defined(__SSE2__) || defined(_M_X64))
+    // each t_word is 64 bits, swap two words per register from both ends
+    double *lo = (double *)vec;
+    double *hi = (double *)(vec + n) - 2;
+    for (; hi - lo >= 2; lo += 2, hi -= 2) {
+        __m128d a = _mm_loadu_pd(lo);
+        __m128d b = _mm_loadu_pd(hi);
+        _mm_storeu_pd(lo, _mm_shuffle_pd(b, b, 1));
+        _mm_storeu_pd(hi, _mm_shuffle_pd(a, a, 1));
+    }
+    std::reverse((t_word *)lo, (t_word *)(hi + 2));
+#else
+    std::reverse(vec, vec + n);
+#endif
+}
+
+// ─────────────────────────────────────
+static t_garray *arrayinvert_range(arrayinvert *x, int argc, t_atom *argv, t_word **vec,
+                                   int *start, int *end) {
+    if (!x->arr.get(x, "a.invert")) {
+        return nullptr;
+    }
+    *vec = x->arr.vec;
+    int vecsize = x->arr.size;
+
+    // optional [start, end) range, end <= 0 means the end of the array
+    *start = 0;
+    *end = vecsize;
+    if (argc > 0) {
+        *start = std::clamp((int)atom_getfloat(argv), 0, vecsize);
+    }
+    if (argc > 1 && atom_getfloat(argv + 1) > 0) {
+        *end = std::clamp((int)atom_getfloat(argv + 1), *start, vecsize);
+    }
+    return x->arr.array;
+}
+
+// ─────────────────────────────────────
+static void arrayinvert_methods(arrayinvert *x, t_symbol *s, int argc, t_atom *argv) {
+    t_word *vec;
+    int start, end;
+    t_garray *array = arrayinvert_range(x, argc, argv, &vec, &start, &end);
+    if (!array) {
         return;
     }
 
-    return;
+    std::string method = s->s_name;
+    if (method == "reverse") {
+        arrayinvert_reverse(vec + start, end - start);
+    } else if (method == "negate") {
+        arrayinvert_transform<invert_negate>(vec + start, end - start);
+    } else if (method == "reciprocal") {
+        arrayinvert_transform<invert_reciprocal>(vec + start, end - start);
+    } else if (method == "complement") {
+        arrayinvert_transform<invert_complement>(vec + start, end - start);
+    }
+    xlab_redraw::request(x->arr);
 }
 
 // ─────────────────────────────────────
-static void *arrayinvert_new(t_symbol *s, t_float f) {
+static void arrayinvert_bang(arrayinvert *x) {
+    arrayinvert_methods(x, gensym("reverse"), 0, nullptr);
+}
+
+// ─────────────────────────────────────
+static void arrayinvert_set(arrayinvert *x, t_symbol *s) { x->arr.set(s); }
+
+// ─────────────────────────────────────
+static void *arrayinvert_new(t_symbol *s) {
     arrayinvert *x = (arrayinvert *)pd_new(neimog_arrayinvert);
+    x->arr.set(s);
     return (x);
 }
 
 // ─────────────────────────────────────
 void arrayinvert_setup(void) {
     neimog_arrayinvert = class_new(gensym("a.invert"), (t_newmethod)arrayinvert_new, 0,
-                                   sizeof(arrayinvert), 0, A_SYMBOL, A_FLOAT, 0);
+                                   sizeof(arrayinvert), 0, A_SYMBOL, 0);
 
     class_addbang(neimog_arrayinvert, (t_method)arrayinvert_bang);
+    class_addmethod(neimog_arrayinvert, (t_method)arrayinvert_set, gensym("set"), A_SYMBOL, 0);
+    class_addmethod(neimog_arrayinvert, (t_method)arrayinvert_methods, gensym("reverse"), A_GIMME,
+                    0);
+    class_addmethod(neimog_arrayinvert, (t_method)arrayinvert_methods, gensym("negate"), A_GIMME,
+                    0);
+    class_addmethod(neimog_arrayinvert, (t_method)arrayinvert_methods, gensym("reciprocal"),
+                    A_GIMME, 0);
+    class_addmethod(neimog_arrayinvert, (t_method)arrayinvert_methods, gensym("complement"),
+                    A_GIMME, 0);
 }
@@ -1,7 +1,8 @@
 #include <algorithm>
+#include <cstring>
 #include <m_pd.h>
-#include <string>
-#include <vector>
+
+#include "xlab-array.hpp"
 
 static t_class *neimog_arrayrotate;
 
@@ -11,64 +12,128 @@ class arrayrotate {
     t_object obj;
     unsigned redrawat;
     unsigned redrawcount;
-    std::string arrayname;
+    xlab_array arr;
+
+    // ring mode: the array is a circular buffer and head is the index of the oldest value
+    bool ring;
+    int head;
+    t_outlet *out;
 };
 
+// ─────────────────────────────────────
 static void arrayrotate_redraw(arrayrotate *x, t_float f) {
     x->redrawat = f;
     return;
 }
 
+// ─────────────────────────────────────
+static void arrayrotate_ring(arrayrotate *x, t_float f) {
+    bool ring = f != 0;
+    if (ring == x->ring) {
+        return;
+    }
+
+    // leaving ring mode, put the oldest value back at index 0 so the array reads in order
+    if (!ring && x->head != 0) {
+        if (x->arr.get(x, "a.rotate") && x->arr.size > 0) {
+            t_word *vec = x->arr.vec;
+            std::rotate(vec, vec + (x->head % x->arr.size), vec + x->arr.size);
+            xlab_redraw::request(x->arr);
+        }
+    }
+    x->ring = ring;
+    x->head = 0;
+}
+
 // ─────────────────────────────────────
 static void arrayrotate_rotate(arrayrotate *x, t_symbol *s, int argc, t_atom *argv) {
 
     for (int i = 0; i < argc; i++) {
         if (argv[i].a_type != A_FLOAT) {
-            pd_error(x, "All arguments must be floats");
+            pd_error(x, "[a.rotate] All arguments must be floats");
             return;
         }
     }
 
-    t_garray *array;
-    int vecsize;
-    t_word *vec;
-
-    t_symbol *pd_symbol = gensym(x->arrayname.c_str());
-    if (!(array = (t_garray *)pd_findbyclass(pd_symbol, garray_class))) {
-        pd_error(x, "[Python] Array %s not found.", x->arrayname.c_str());
+    if (!x->arr.get(x, "a.rotate") || x->arr.size == 0) {
         return;
-    } else if (!garray_getfloatwords(array, &vecsize, &vec)) {
-        pd_error(x, "[Python] Bad template for tabwrite '%s'.", x->arrayname.c_str());
-        return;
-    }
-
-    std::vector<float> inBuffer;
-    for (int i = 0; i < vecsize; i++) {
-        inBuffer.push_back(vec[i].w_float);
     }
-    std::rotate(inBuffer.begin(), inBuffer.begin() + argc, inBuffer.end());
+    t_word *vec = x->arr.vec;
+    int vecsize = x->arr.size;
 
-    for (int i = 0; i < vecsize; i++) {
-        vec[i].w_float = inBuffer[i];
+    // only the last vecsize values of a longer list survive
+    if (argc > vecsize) {
+        argv += argc - vecsize;
+        argc = vecsize;
     }
 
-    for (int i = 0; i < argc; i++) {
-        int index = vecsize - argc + i;
-        vec[index].w_float = atom_getfloat(argv + i);
+    if (x->ring) {
+        int head = x->head % vecsize;
+        for (int i = 0; i < argc; i++) {
+            vec[head].w_float = atom_getfloat(argv + i);
+            if (++head == vecsize) {
+                head = 0;
+            }
+        }
+        x->head = head;
+        outlet_float(x->out, head);
+    } else {
+        std::memmove(vec, vec + argc, (vecsize - argc) * sizeof(t_word));
+        for (int i = 0; i < argc; i++) {
+            int index = vecsize - argc + i;
+            vec[index].w_float = atom_getfloat(argv + i);
+        }
     }
 
     x->redrawcount++;
     if (x->redrawcount >= x->redrawat) {
-        garray_redraw(array);
+        xlab_redraw::request(x->arr);
         x->redrawcount = 0;
     }
     return;
 }
 
+// ─────────────────────────────────────
+static void arrayrotate_linearize(arrayrotate *x, t_symbol *s, t_float f) {
+    if (!x->arr.get(x, "a.rotate") || x->arr.size == 0) {
+        return;
+    } else if (s == x->arr.name) {
+        pd_error(x, "[a.rotate] Can't linearize '%s' into itself.", s->s_name);
+        return;
+    }
+    t_word *vec = x->arr.vec;
+    int vecsize = x->arr.size;
+
+    // copy the newest n values, oldest first, into the target array
+    int n = f > 0 ? std::min((int)f, vecsize) : vecsize;
+    xlab_array dest;
+    dest.set(s);
+    if (!dest.get(x, "a.rotate")) {
+        return;
+    }
+    if (dest.size != n && !dest.resize(x, "a.rotate", n)) {
+        return;
+    }
+    t_word *target = dest.vec;
+
+    int head = x->ring ? x->head % vecsize : 0;
+    int start = head - n;
+    if (start < 0) {
+        start += vecsize;
+    }
+    int first = std::min(n, vecsize - start);
+    std::memcpy(target, vec + start, first * sizeof(t_word));
+    std::memcpy(target + first, vec, (n - first) * sizeof(t_word));
+    xlab_redraw::request(dest);
+}
+
 // ─────────────────────────────────────
 static void *arrayrotate_new(t_symbol *s) {
     arrayrotate *x = (arrayrotate *)pd_new(neimog_arrayrotate);
-    x->arrayname = s->s_name;
+    x->arr.set(s);
+    x->ring = false;
+    x->head = 0;
+    x->out = outlet_new(&x->obj, &s_float);
     return (x);
 }
 
@@ -79,4 +144,7 @@ void arrayrotate_setup(void) {
 
     class_addlist(neimog_arrayrotate, (t_method)arrayrotate_rotate);
     class_addmethod(neimog_arrayrotate, (t_method)arrayrotate_redraw, gensym("redraw"), A_FLOAT, 0);
+    class_addmethod(neimog_arrayrotate, (t_method)arrayrotate_ring, gensym("ring"), A_FLOAT, 0);
+    class_addmethod(neimog_arrayrotate, (t_method)arrayrotate_linearize, gensym("linearize"),
+                    A_SYMBOL, A_DEFFLOAT, 0);
 }
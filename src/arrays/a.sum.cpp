@@ -1,5 +1,6 @@
 #include <m_pd.h>
-#include <string>
+
+#include "xlab-array.hpp"
 
 static t_class *neimog_arraysum;
 
@@ -8,28 +9,22 @@ class arraysum {
   public:
     t_object obj;
     unsigned sumlast;
-    std::string arrayname;
+    xlab_array arr;
     t_outlet *out;
 };
 
 // ─────────────────────────────────────
 static void arraysum_sum(arraysum *x) {
-    t_garray *array;
-    int vecsize;
-    t_word *vec;
-
-    t_symbol *pd_symbol = gensym(x->arrayname.c_str());
-    if (!(array = (t_garray *)pd_findbyclass(pd_symbol, garray_class))) {
-        pd_error(x, "[Python] Array %s not found.", x->arrayname.c_str());
-        return;
-    } else if (!garray_getfloatwords(array, &vecsize, &vec)) {
-        pd_error(x, "[Python] Bad template for tabwrite '%s'.", x->arrayname.c_str());
+    if (!x->arr.get(x, "a.sum")) {
         return;
     }
+    t_word *vec = x->arr.vec;
+    int vecsize = x->arr.size;
 
-    int index = vecsize - x->sumlast;
-    float sum = 0;
-    for (int i = vecsize - x->sumlast; i < vecsize; i++) {
+    // for sums updated on every new value use [a.window], which keeps them incrementally
+    int start = (int)x->sumlast < vecsize ? vecsize - x->sumlast : 0;
+    double sum = 0;
+    for (int i = start; i < vecsize; i++) {
         sum += vec[i].w_float;
     }
     outlet_float(x->out, sum);
@@ -39,7 +34,7 @@ static void arraysum_sum(arraysum *x) {
 // ─────────────────────────────────────
 static void *arraysum_new(t_symbol *s, t_float f) {
     arraysum *x = (arraysum *)pd_new(neimog_arraysum);
-    x->arrayname = s->s_name;
+    x->arr.set(s);
     x->sumlast = f;
     x->out = outlet_new(&x->obj, &s_float);
     return (x);
@@ -0,0 +1,253 @@
+#include <m_pd.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "xlab-array.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Sliding window statistics. Values  │
+// │  are pushed one by one (or as a     │
+// │  list) and the object keeps sum,    │
+// │  mean, variance, min and max of the │
+// │  last N values up to date, so each  │
+// │  bang costs O(1) whatever N is.     │
+// ╰─────────────────────────────────────╯
+
+static t_class *neimog_arraywindow;
+
+// ─────────────────────────────────────
+// Deque of sequence numbers whose values are monotonic, used for min and max
+class monotonic {
+  public:
+    std::vector<uint64_t> seq;
+    unsigned first;
+    unsigned len;
+
+    void reset(unsigned size) {
+        seq.assign(size, 0);
+        first = 0;
+        len = 0;
+    }
+    uint64_t front() const { return seq[first]; }
+    uint64_t back() const { return seq[(first + len - 1) % seq.size()]; }
+    void pop_front() {
+        first = (first + 1) % seq.size();
+        len--;
+    }
+    void pop_back() { len--; }
+    void push_back(uint64_t s) {
+        seq[(first + len) % seq.size()] = s;
+        len++;
+    }
+};
+
+// ─────────────────────────────────────
+class arraywindow {
+  public:
+    t_object obj;
+    unsigned size;
+    unsigned count;
+    uint64_t seq;
+    unsigned evicted;
+    std::vector<double> values;
+
+    // Neumaier compensated sum
+    double sum;
+    double comp;
+
+    // Welford
+    double mean;
+    double m2;
+
+    monotonic min;
+    monotonic max;
+
+    t_outlet *sum_out;
+    t_outlet *mean_out;
+    t_outlet *var_out;
+    t_outlet *min_out;
+    t_outlet *max_out;
+};
+
+// ─────────────────────────────────────
+static void arraywindow_accumulate(arraywindow *x, double v) {
+    double t = x->sum + v;
+    if (fabs(x->sum) >= fabs(v)) {
+        x->comp += (x->sum - t) + v;
+    } else {
+        x->comp += (v - t) + x->sum;
+    }
+    x->sum = t;
+}
+
+// ─────────────────────────────────────
+static double arraywindow_at(arraywindow *x, uint64_t s) { return x->values[s % x->size]; }
+
+// ─────────────────────────────────────
+static void arraywindow_clear(arraywindow *x) {
+    x->values.assign(x->size, 0);
+    x->count = 0;
+    x->seq = 0;
+    x->evicted = 0;
+    x->sum = 0;
+    x->comp = 0;
+    x->mean = 0;
+    x->m2 = 0;
+    x->min.reset(x->size);
+    x->max.reset(x->size);
+}
+
+// ─────────────────────────────────────
+// Welford with removals slowly drifts, so once every `size` evictions the
+// running values are rebuilt from the stored window (O(1) amortized).
+static void arraywindow_refresh(arraywindow *x) {
+    x->sum = 0;
+    x->comp = 0;
+    x->mean = 0;
+    x->m2 = 0;
+    for (unsigned i = 0; i < x->count; i++) {
+        double v = arraywindow_at(x, x->seq - x->count + i);
+        arraywindow_accumulate(x, v);
+        double delta = v - x->mean;
+        x->mean += delta / (i + 1);
+        x->m2 += delta * (v - x->mean);
+    }
+    x->evicted = 0;
+}
+
+// ─────────────────────────────────────
+static void arraywindow_push(arraywindow *x, double v) {
+    uint64_t s = x->seq;
+    if (x->count == x->size) {
+        double old = arraywindow_at(x, s);
+        arraywindow_accumulate(x, -old);
+        double mean = x->mean + (v - old) / x->count;
+        x->m2 += (v - old) * (v - mean + old - x->mean);
+        if (x->m2 < 0) {
+            x->m2 = 0;
+        }
+        x->mean = mean;
+        x->evicted++;
+    } else {
+        x->count++;
+        double delta = v - x->mean;
+        x->mean += delta / x->count;
+        x->m2 += delta * (v - x->mean);
+    }
+    arraywindow_accumulate(x, v);
+    x->values[s % x->size] = v;
+    x->seq = s + 1;
+
+    // drop values that left the window, then the ones that can never be the extreme again
+    while (x->min.len && x->min.front() + x->size <= s) {
+        x->min.pop_front();
+    }
+    while (x->max.len && x->max.front() + x->size <= s) {
+        x->max.pop_front();
+    }
+    while (x->min.len && arraywindow_at(x, x->min.back()) >= v) {
+        x->min.pop_back();
+    }
+    while (x->max.len && arraywindow_at(x, x->max.back()) <= v) {
+        x->max.pop_back();
+    }
+    x->min.push_back(s);
+    x->max.push_back(s);
+
+    if (x->evicted >= x->size) {
+        arraywindow_refresh(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void arraywindow_bang(arraywindow *x) {
+    if (x->count == 0) {
+        return;
+    }
+    double variance = x->count > 1 ? x->m2 / (x->count - 1) : 0;
+    outlet_float(x->max_out, arraywindow_at(x, x->max.front()));
+    outlet_float(x->min_out, arraywindow_at(x, x->min.front()));
+    outlet_float(x->var_out, variance);
+    outlet_float(x->mean_out, x->mean);
+    outlet_float(x->sum_out, x->sum + x->comp);
+}
+
+// ─────────────────────────────────────
+static void arraywindow_float(arraywindow *x, t_float f) { arraywindow_push(x, f); }
+
+// ─────────────────────────────────────
+static void arraywindow_list(arraywindow *x, t_symbol *s, int argc, t_atom *argv) {
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type != A_FLOAT) {
+            pd_error(x, "[a.window] All arguments must be floats");
+            return;
+        }
+    }
+    for (int i = 0; i < argc; i++) {
+        arraywindow_push(x, atom_getfloat(argv + i));
+    }
+}
+
+// ─────────────────────────────────────
+static void arraywindow_load(arraywindow *x, t_symbol *s) {
+    xlab_array arr;
+    arr.set(s);
+    if (!arr.get(x, "a.window")) {
+        return;
+    }
+    t_word *vec = arr.vec;
+    int vecsize = arr.size;
+
+    // seed the window with the last values of the array
+    arraywindow_clear(x);
+    int start = vecsize > (int)x->size ? vecsize - x->size : 0;
+    for (int i = start; i < vecsize; i++) {
+        arraywindow_push(x, vec[i].w_float);
+    }
+}
+
+// ─────────────────────────────────────
+static void arraywindow_size(arraywindow *x, t_float f) {
+    if (f < 1) {
+        pd_error(x, "[a.window] size must be at least 1");
+        return;
+    }
+    x->size = f;
+    arraywindow_clear(x);
+}
+
+// ─────────────────────────────────────
+static void *arraywindow_new(t_float f) {
+    arraywindow *x = (arraywindow *)pd_new(neimog_arraywindow);
+    x->size = f < 1 ? 64 : f;
+    arraywindow_clear(x);
+
+    x->sum_out = outlet_new(&x->obj, &s_float);
+    x->mean_out = outlet_new(&x->obj, &s_float);
+    x->var_out = outlet_new(&x->obj, &s_float);
+    x->min_out = outlet_new(&x->obj, &s_float);
+    x->max_out = outlet_new(&x->obj, &s_float);
+    return (x);
+}
+
+// ─────────────────────────────────────
+static void arraywindow_free(arraywindow *x) {
+    x->values.~vector();
+    x->min.seq.~vector();
+    x->max.seq.~vector();
+}
+
+// ─────────────────────────────────────
+void arraywindow_setup(void) {
+    neimog_arraywindow =
+        class_new(gensym("a.window"), (t_newmethod)arraywindow_new, (t_method)arraywindow_free,
+                  sizeof(arraywindow), 0, A_DEFFLOAT, 0);
+
+    class_addbang(neimog_arraywindow, (t_method)arraywindow_bang);
+    class_addfloat(neimog_arraywindow, (t_method)arraywindow_float);
+    class_addlist(neimog_arraywindow, (t_method)arraywindow_list);
+    class_addmethod(neimog_arraywindow, (t_method)arraywindow_load, gensym("load"), A_SYMBOL, 0);
+    class_addmethod(neimog_arraywindow, (t_method)arraywindow_size, gensym("size"), A_FLOAT, 0);
+    class_addmethod(neimog_arraywindow, (t_method)arraywindow_clear, gensym("clear"), A_NULL);
+}
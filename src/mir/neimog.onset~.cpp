@@ -1,45 +1,164 @@
+#include <algorithm>
 #include <m_pd.h>
 #include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "xlab-spectrum.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Onset detection.                   │
+// │    [n.onset~ <threshold> <size>     │
+// │              <hop>]                 │
+// │  A Hann-windowed spectrum of size   │
+// │  samples is taken every hop         │
+// │  samples, whatever the block size,  │
+// │  and reduced to one detection value │
+// │  per frame:                         │
+// │    method flux     rectified flux   │
+// │                    of log spectra   │
+// │    method complex  rectified        │
+// │                    complex domain   │
+// │  A frame is an onset when it is a   │
+// │  local peak above the mean of the   │
+// │  last frames plus threshold, and at │
+// │  least mininterval ms after the     │
+// │  previous one. Outlets: bang, the   │
+// │  detection value and the adaptive   │
+// │  threshold, once per frame.         │
+// ╰─────────────────────────────────────╯
+
+#define NONSET_HISTORY 8
 
 static t_class *nonset_tilde_class;
 
+enum { NONSET_FLUX, NONSET_COMPLEX };
+
 class nonset {
   public:
     t_object x_obj;
     t_sample x_f;
     t_clock *x_clock;
-    t_int rms_window;
-    double previous_rms;
-    t_int index;
-    t_int iterations;
-    double init_value;
+    xlab_spectrum *spectrum;
+    int method;
+    t_float threshold;
+    t_float mininterval;
+    t_float sr;
 
-    double noise_covariance;
-    double kalman;
-    double diff;
+    // previous frame, log magnitudes for flux, the last two spectra for complex
+    std::vector<float> prev_mag;
+    std::vector<float> prev_re;
+    std::vector<float> prev_im;
+    std::vector<float> prev2_re;
+    std::vector<float> prev2_im;
+    int seeded;
 
-    double *history;
+    // detection values of the last three frames, newest first
+    double detection[3];
+    double history[NONSET_HISTORY];
+    int history_index;
+    double adaptive;
+    double since;
+    bool onset;
 
-    unsigned int buffer_pointer;
-    t_float threshold;
-
-    t_outlet *diff_out;
-    t_outlet *detection_out;
     t_outlet *bang_out;
+    t_outlet *detection_out;
+    t_outlet *threshold_out;
 };
 
 // ─────────────────────────────────────
 static void nonset_tick(nonset *x) {
-    if (isnan(x->kalman)) {
-        x->kalman = 0;
+    outlet_float(x->threshold_out, x->adaptive);
+    outlet_float(x->detection_out, x->detection[1]);
+    if (x->onset) {
+        x->onset = false;
+        outlet_bang(x->bang_out);
+    }
+}
+
+// ─────────────────────────────────────
+// Magnitudes are scaled so that a full scale sine peaks near 1, flux uses
+// log(1 + 100 |X|) so quiet and loud attacks weigh alike.
+static double nonset_flux(nonset *x) {
+    const float *mag = x->spectrum->MagP;
+    int bins = x->spectrum->Bins;
+    float scale = 4.0f / x->spectrum->Size;
+    double flux = 0;
+    for (int k = 0; k < bins; k++) {
+        float m = log1pf(100 * scale * mag[k]);
+        float rise = m - x->prev_mag[k];
+        flux += rise > 0 ? rise : 0;
+        x->prev_mag[k] = m;
     }
+    return flux / bins;
+}
 
-    outlet_float(x->detection_out, x->kalman);
-    outlet_float(x->diff_out, x->diff);
+// ─────────────────────────────────────
+// Distance between each bin and its prediction from the previous two frames,
+// same magnitude and a steady phase advance, on rising bins only (Dixon 2006).
+// The prediction |X1| u1^2 conj(u2), u the unit phasors, avoids the atan2.
+// Magnitudes get the same log compression as flux, the phases are kept.
+static double nonset_complex(nonset *x) {
+    const fftwf_complex *spec = x->spectrum->complex();
+    int bins = x->spectrum->Bins;
+    float scale = 4.0f / x->spectrum->Size;
+    double sum = 0;
+    for (int k = 0; k < bins; k++) {
+        float re = spec[k][0];
+        float im = spec[k][1];
+        float m = sqrtf(re * re + im * im);
+        float compress = m > 0 ? log1pf(100 * scale * m) / m : 0;
+        re *= compress;
+        im *= compress;
+        float r1 = x->prev_re[k], i1 = x->prev_im[k];
+        float r2 = x->prev2_re[k], i2 = x->prev2_im[k];
+        float m1 = sqrtf(r1 * r1 + i1 * i1);
+        float m2 = sqrtf(r2 * r2 + i2 * i2);
+        float pr, pi;
+        if (m1 > 0 && m2 > 0) {
+            // u1^2 * conj(u2) * |X1| = X1^2 * conj(X2) / (|X1| |X2|)
+            float qr = r1 * r1 - i1 * i1, qi = 2 * r1 * i1;
+            float norm = 1 / (m1 * m2);
+            pr = (qr * r2 + qi * i2) * norm;
+            pi = (qi * r2 - qr * i2) * norm;
+        } else {
+            pr = r1;
+            pi = i1;
+        }
+        if (re * re + im * im >= m1 * m1) {
+            float dr = re - pr, di = im - pi;
+            sum += sqrtf(dr * dr + di * di);
+        }
+        x->prev2_re[k] = r1;
+        x->prev2_im[k] = i1;
+        x->prev_re[k] = re;
+        x->prev_im[k] = im;
+    }
+    return sum / bins;
+}
 
-    if (x->kalman > x->threshold) {
-        outlet_bang(x->bang_out);
+// ─────────────────────────────────────
+// the middle one of the last three frames is tested, so onsets come one hop late
+static void nonset_peak(nonset *x, double value, bool armed) {
+    x->detection[2] = x->detection[1];
+    x->detection[1] = x->detection[0];
+    x->detection[0] = value;
+
+    double mean = 0;
+    for (int i = 0; i < NONSET_HISTORY; i++) {
+        mean += x->history[i];
+    }
+    mean /= NONSET_HISTORY;
+    x->adaptive = mean + x->threshold;
+
+    double d = x->detection[1];
+    if (armed && d > x->adaptive && d >= x->detection[2] && d > x->detection[0] &&
+        x->since >= x->mininterval * x->sr / 1000) {
+        x->onset = true;
+        x->since = x->spectrum->Hop;
     }
+    x->history[x->history_index] = d;
+    x->history_index = (x->history_index + 1) % NONSET_HISTORY;
 }
 
 // ─────────────────────────────────────
@@ -48,77 +167,123 @@ static t_int *nonset_perform(t_int *w) {
     t_sample *in = (t_sample *)(w[2]);
     int n = (int)(w[3]);
 
-    double sum = 0.0;
-    for (int i = 0; i < n; i++) {
-        sum += in[i] * in[i];
-    }
-    double rms = sqrt(sum / n);
-    double diff = (rms - x->previous_rms) / x->previous_rms;
-    x->diff = 1 - exp(-0.5 * diff);
-
-    // Kalman filter
-    x->history[x->index] = diff;
-    x->index = (x->index + 1) % x->iterations;
-    double Pk = 1;
-    double xk = (double)x->init_value;
-    int i;
-    for (i = 0; i < x->iterations; i++) {
-        double Zk = (double)x->history[(i + x->index) % x->iterations];
-        double Kk = Pk / (Pk + (double)x->noise_covariance);
-        xk = xk + Kk * (Zk - xk);
-        Pk = (1 - Kk) * Pk;
+    x->since += n;
+    if (x->spectrum->push(in, nullptr, n)) {
+        double value = x->method == NONSET_COMPLEX ? nonset_complex(x) : nonset_flux(x);
+        // until the window is full and the previous spectra are from input any
+        // sound reads as an onset against the zeros, those frames are dropped;
+        // then onsets wait for the adaptive threshold to have a full history
+        int warmup = x->spectrum->Size / x->spectrum->Hop + 2;
+        if (x->seeded <= warmup + NONSET_HISTORY) {
+            x->seeded++;
+        }
+        if (x->seeded > warmup) {
+            nonset_peak(x, value, x->seeded > warmup + NONSET_HISTORY);
+            clock_delay(x->x_clock, 0);
+        }
     }
-
-    x->kalman = xk;
-    x->previous_rms = rms;
-    clock_delay(x->x_clock, 0);
     return (w + 4);
 }
 
 // ─────────────────────────────────────
 static void nonset_dsp(nonset *x, t_signal **sp) {
-    if (x->rms_window == 0) {
-        x->rms_window = sp[0]->s_n;
-    }
+    x->sr = sp[0]->s_sr;
     dsp_add(nonset_perform, 3, x, sp[0]->s_vec, sp[0]->s_n);
 }
 
+// ─────────────────────────────────────
+static void nonset_restart(nonset *x) {
+    x->seeded = 0;
+    std::fill(x->detection, x->detection + 3, 0.0);
+    std::fill(x->history, x->history + NONSET_HISTORY, 0.0);
+}
+
+// ─────────────────────────────────────
+static void nonset_window(nonset *x, t_float size, t_float hop) {
+    int n = size;
+    if (n < 64 || (n & (n - 1)) != 0) {
+        pd_error(x, "[n.onset~] window size must be a power of 2 of at least 64");
+        return;
+    }
+    int h = hop > 0 ? hop : n / 4;
+    delete x->spectrum;
+    x->spectrum = new xlab_spectrum(n, std::clamp(h, 1, n), xlab_spectrum::HANN, false);
+    int bins = x->spectrum->Bins;
+    x->prev_mag.assign(bins, 0);
+    x->prev_re.assign(bins, 0);
+    x->prev_im.assign(bins, 0);
+    x->prev2_re.assign(bins, 0);
+    x->prev2_im.assign(bins, 0);
+    nonset_restart(x);
+}
+
+// ─────────────────────────────────────
+static void nonset_method(nonset *x, t_symbol *s) {
+    if (s == gensym("flux")) {
+        x->method = NONSET_FLUX;
+    } else if (s == gensym("complex")) {
+        x->method = NONSET_COMPLEX;
+    } else {
+        pd_error(x, "[n.onset~] method must be flux or complex");
+        return;
+    }
+    // the previous spectra of the other method are stale
+    nonset_restart(x);
+}
+
+// ─────────────────────────────────────
+static void nonset_threshold(nonset *x, t_float f) { x->threshold = f; }
+
+// ─────────────────────────────────────
+static void nonset_mininterval(nonset *x, t_float f) { x->mininterval = f < 0 ? 0 : f; }
+
 // ─────────────────────────────────────
 // Constructor
-static void *nonset_new(t_floatarg threshold) {
+static void *nonset_new(t_symbol *s, int argc, t_atom *argv) {
     nonset *x = (nonset *)pd_new(nonset_tilde_class);
-    x->rms_window = 0;
-    x->previous_rms = 0.e-21;
-    x->history = new double[100];
-    for (int i = 0; i < 100; i++) {
-        x->history[i] = x->init_value;
+    x->threshold = argc > 0 ? atom_getfloat(argv) : 0.003;
+    x->mininterval = 50;
+    x->sr = sys_getsr();
+    x->since = INFINITY;
+    nonset_window(x, argc > 1 ? atom_getfloat(argv + 1) : 1024,
+                  argc > 2 ? atom_getfloat(argv + 2) : 128);
+    if (!x->spectrum) {
+        nonset_window(x, 1024, 128);
     }
 
-    x->iterations = 20;
-    x->noise_covariance = 2;
-    x->init_value = 0;
-    x->index = 0;
-    x->threshold = threshold;
-
     x->x_clock = clock_new(x, (t_method)nonset_tick);
-
     x->bang_out = outlet_new(&x->x_obj, &s_bang);
     x->detection_out = outlet_new(&x->x_obj, &s_float);
-    x->diff_out = outlet_new(&x->x_obj, &s_float);
+    x->threshold_out = outlet_new(&x->x_obj, &s_float);
     return (void *)x;
 }
 
 // ─────────────────────────────────────
 // Destructor
-static void nonset_free(nonset *x) {}
+static void nonset_free(nonset *x) {
+    clock_free(x->x_clock);
+    delete x->spectrum;
+    x->prev_mag.~vector();
+    x->prev_re.~vector();
+    x->prev_im.~vector();
+    x->prev2_re.~vector();
+    x->prev2_im.~vector();
+}
 
 // ─────────────────────────────────────
 // Setup Function
 void nonset_tilde_setup(void) {
     nonset_tilde_class =
         class_new(gensym("n.onset~"), (t_newmethod)nonset_new, (t_method)nonset_free,
-                  sizeof(nonset), CLASS_DEFAULT, A_DEFFLOAT, 0);
+                  sizeof(nonset), CLASS_DEFAULT, A_GIMME, 0);
 
     CLASS_MAINSIGNALIN(nonset_tilde_class, nonset, x_f);
     class_addmethod(nonset_tilde_class, (t_method)nonset_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(nonset_tilde_class, (t_method)nonset_method, gensym("method"), A_SYMBOL, 0);
+    class_addmethod(nonset_tilde_class, (t_method)nonset_window, gensym("window"), A_FLOAT,
+                    A_DEFFLOAT, 0);
+    class_addmethod(nonset_tilde_class, (t_method)nonset_threshold, gensym("threshold"), A_FLOAT,
+                    0);
+    class_addmethod(nonset_tilde_class, (t_method)nonset_mininterval, gensym("mininterval"),
+                    A_FLOAT, 0);
 }
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <m_pd.h>
+#include <math.h>
+#include <utility>
+#include <vector>
+
+#include "xlab-array.hpp"
+#include "xlab-simd.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Dynamic time warping distance      │
+// │  between sequences of different     │
+// │  lengths, sqrt of the smallest sum  │
+// │  of squared frame distances along a │
+// │  warping path.                      │
+// │    [dtw <band> <dim>]               │
+// │  band is the Sakoe-Chiba radius in  │
+// │  frames around the diagonal, 0 for  │
+// │  none, dim the values per frame of  │
+// │  the interleaved lists and arrays.  │
+// │  The left inlet compares a list     │
+// │  with the one in the right inlet;   │
+// │    templates <array> ...            │
+// │    match [list]                     │
+// │  outputs [nearest <index> <dist>(   │
+// │  of the templates, pruned with      │
+// │  LB_Keogh and early abandoning.     │
+// ╰─────────────────────────────────────╯
+
+static t_class *Dtw;
+
+// ─────────────────────────────────────
+class dtw {
+  public:
+    t_object Obj;
+    t_outlet *Out;
+    int Band;
+    int Dim;
+
+    std::vector<float> Input;
+    std::vector<float> Reference;
+    std::vector<xlab_array> Templates;
+
+    // work buffers, reused between calls
+    std::vector<float> Frames;
+    std::vector<float> Columns;
+    std::vector<float> Prev;
+    std::vector<float> Cur;
+    std::vector<float> Cost;
+    std::vector<float> Step;
+    std::vector<float> Upper;
+    std::vector<float> Lower;
+    std::vector<std::pair<float, int>> Bounds;
+};
+
+// ─────────────────────────────────────
+// Squared DTW of n row frames against m column frames, n >= m. The rows are
+// frame-major, the columns dimension-major with a stride of at least m + 4 so
+// the cost of a whole band row is computed 4 columns at a time. Only two band
+// rows are kept: entry k + 1 of a row is column lo + k, entry 0 and the tail
+// are +inf. Returns +inf as soon as a whole row exceeds best.
+static float dtw_distance(dtw *x, const float *a, int n, const float *bt, int m, int stride,
+                          float best) {
+    const float inf = INFINITY;
+    int d = x->Dim;
+    int r = x->Band > 0 ? x->Band : m;
+    int width = std::min(2 * r + 1, m) + 16;
+    x->Prev.assign(width, inf);
+    x->Cur.assign(width, inf);
+    x->Cost.resize(width);
+    x->Step.resize(width);
+    float *prev = x->Prev.data();
+    float *cur = x->Cur.data();
+    float *cost = x->Cost.data();
+    float *step = x->Step.data();
+
+    // virtual row -1, D(-1, -1) = 0
+    prev[0] = 0;
+    int loprev = 0;
+    for (int i = 0; i < n; i++) {
+        int c = n > 1 ? (long)i * (m - 1) / (n - 1) : 0;
+        int lo = std::max(0, c - r);
+        int hi = std::min(m - 1, c + r);
+        int w = hi - lo + 1;
+        int s = lo - loprev;
+
+        const float *frame = a + (size_t)i * d;
+        for (int k = 0; k < w; k += 4) {
+            xlab_vfloat acc = xlab_vdup(0);
+            for (int j = 0; j < d; j++) {
+                xlab_vfloat col = xlab_vload(bt + j * stride + lo + k);
+                xlab_vfloat diff = xlab_vsub(xlab_vdup(frame[j]), col);
+                acc = xlab_vadd(acc, xlab_vmul(diff, diff));
+            }
+            xlab_vstore(cost + k, acc);
+            // diagonal and vertical predecessors, columns j - 1 and j of the previous row
+            xlab_vfloat diagonal = xlab_vload(prev + s + k);
+            xlab_vstore(step + k, xlab_vmin(diagonal, xlab_vload(prev + s + k + 1)));
+        }
+
+        // the horizontal predecessor is the only sequential dependency
+        float left = inf;
+        float rowmin = inf;
+        cur[0] = inf;
+        for (int k = 0; k < w; k++) {
+            left = cost[k] + std::min(step[k], left);
+            cur[k + 1] = left;
+            rowmin = std::min(rowmin, left);
+        }
+        std::fill(cur + w + 1, cur + std::min(w + 9, width), inf);
+        if (rowmin > best) {
+            return inf;
+        }
+        std::swap(prev, cur);
+        loprev = lo;
+    }
+    return prev[m - loprev];
+}
+
+// ─────────────────────────────────────
+// the longer sequence becomes the rows, the other one is transposed
+static float dtw_compare(dtw *x, const float *p, int np, const float *q, int nq, float best) {
+    if (np < nq) {
+        std::swap(p, q);
+        std::swap(np, nq);
+    }
+    int d = x->Dim;
+    int stride = (nq + 3) / 4 * 4 + 4;
+    x->Columns.assign((size_t)d * stride, 0);
+    for (int i = 0; i < nq; i++) {
+        for (int j = 0; j < d; j++) {
+            x->Columns[(size_t)j * stride + i] = q[(size_t)i * d + j];
+        }
+    }
+    return dtw_distance(x, p, np, x->Columns.data(), nq, stride, best);
+}
+
+// ─────────────────────────────────────
+// upper and lower envelope of the query over the band, per dimension
+static void dtw_envelope(dtw *x, const float *q, int n) {
+    int d = x->Dim;
+    int r = x->Band > 0 ? x->Band : n;
+    x->Upper.resize((size_t)n * d);
+    x->Lower.resize((size_t)n * d);
+    for (int i = 0; i < n; i++) {
+        int lo = std::max(0, i - r);
+        int hi = std::min(n - 1, i + r);
+        for (int j = 0; j < d; j++) {
+            float u = q[(size_t)lo * d + j];
+            float l = u;
+            for (int k = lo + 1; k <= hi; k++) {
+                u = std::max(u, q[(size_t)k * d + j]);
+                l = std::min(l, q[(size_t)k * d + j]);
+            }
+            x->Upper[(size_t)i * d + j] = u;
+            x->Lower[(size_t)i * d + j] = l;
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// LB_Keogh: every frame of an equal-length candidate is matched to some query
+// frame inside the band, so its distance to the envelope is a lower bound
+static float dtw_lbkeogh(dtw *x, const t_word *c, int n) {
+    int size = n * x->Dim;
+    const float *u = x->Upper.data();
+    const float *l = x->Lower.data();
+    float lb = 0;
+    for (int i = 0; i < size; i++) {
+        float v = c[i].w_float;
+        float e = v > u[i] ? v - u[i] : (v < l[i] ? l[i] - v : 0);
+        lb += e * e;
+    }
+    return lb;
+}
+
+// ─────────────────────────────────────
+static bool dtw_frames(dtw *x, int count, int *frames) {
+    if (count == 0 || count % x->Dim != 0) {
+        pd_error(x, "[dtw] sequence size must be a multiple of %d", x->Dim);
+        return false;
+    }
+    *frames = count / x->Dim;
+    return true;
+}
+
+// ─────────────────────────────────────
+static void dtw_setlist(std::vector<float> &v, int argc, t_atom *argv) {
+    v.resize(argc);
+    for (int i = 0; i < argc; i++) {
+        v[i] = atom_getfloat(argv + i);
+    }
+}
+
+// ─────────────────────────────────────
+static void dtw_list(dtw *x, t_symbol *s, int argc, t_atom *argv) {
+    int np, nq;
+    dtw_setlist(x->Input, argc, argv);
+    if (!dtw_frames(x, x->Input.size(), &np) || !dtw_frames(x, x->Reference.size(), &nq)) {
+        return;
+    }
+    float d = dtw_compare(x, x->Input.data(), np, x->Reference.data(), nq, INFINITY);
+    outlet_float(x->Out, sqrtf(d));
+}
+
+// ─────────────────────────────────────
+static void dtw_reference(dtw *x, t_symbol *s, int argc, t_atom *argv) {
+    dtw_setlist(x->Reference, argc, argv);
+}
+
+// ─────────────────────────────────────
+static void dtw_templates(dtw *x, t_symbol *s, int argc, t_atom *argv) {
+    x->Templates.clear();
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type != A_SYMBOL) {
+            pd_error(x, "[dtw] templates must be array names");
+            x->Templates.clear();
+            return;
+        }
+        xlab_array arr;
+        arr.set(atom_getsymbol(argv + i));
+        x->Templates.push_back(arr);
+    }
+}
+
+// ─────────────────────────────────────
+// Templates as long as the query are visited by increasing LB_Keogh and the
+// search stops at the first bound above the best distance so far. The others
+// have no valid bound and are compared after, with early abandoning only.
+static void dtw_match(dtw *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0) {
+        dtw_setlist(x->Input, argc, argv);
+    }
+    int n;
+    if (x->Templates.empty()) {
+        pd_error(x, "[dtw] no templates, send templates first");
+        return;
+    } else if (!dtw_frames(x, x->Input.size(), &n)) {
+        return;
+    }
+    for (xlab_array &arr : x->Templates) {
+        int frames;
+        if (!arr.get(x, "dtw") || !dtw_frames(x, arr.size, &frames)) {
+            return;
+        }
+    }
+
+    dtw_envelope(x, x->Input.data(), n);
+    x->Bounds.clear();
+    for (int t = 0; t < (int)x->Templates.size(); t++) {
+        xlab_array &arr = x->Templates[t];
+        bool equal = arr.size == (int)x->Input.size();
+        x->Bounds.push_back({equal ? dtw_lbkeogh(x, arr.vec, n) : INFINITY, t});
+    }
+    std::sort(x->Bounds.begin(), x->Bounds.end());
+
+    float best = INFINITY;
+    int nearest = -1;
+    for (const auto &bound : x->Bounds) {
+        xlab_array &arr = x->Templates[bound.second];
+        if (bound.first < INFINITY && bound.first >= best) {
+            continue;
+        }
+        x->Frames.resize(arr.size);
+        for (int i = 0; i < arr.size; i++) {
+            x->Frames[i] = arr.vec[i].w_float;
+        }
+        float d = dtw_compare(x, x->Input.data(), n, x->Frames.data(), arr.size / x->Dim, best);
+        if (d < best) {
+            best = d;
+            nearest = bound.second;
+        }
+    }
+    if (nearest < 0) {
+        return;
+    }
+    t_atom out[2];
+    SETFLOAT(out, nearest);
+    SETFLOAT(out + 1, sqrtf(best));
+    outlet_anything(x->Out, gensym("nearest"), 2, out);
+}
+
+// ─────────────────────────────────────
+static void dtw_band(dtw *x, t_float f) { x->Band = f < 0 ? 0 : f; }
+
+// ─────────────────────────────────────
+static void dtw_dim(dtw *x, t_float f) { x->Dim = f < 1 ? 1 : f; }
+
+// ─────────────────────────────────────
+static void *dtw_new(t_symbol *s, int argc, t_atom *argv) {
+    dtw *x = (dtw *)pd_new(Dtw);
+    dtw_band(x, argc > 0 ? atom_getfloat(argv) : 0);
+    dtw_dim(x, argc > 1 ? atom_getfloat(argv + 1) : 1);
+    inlet_new(&x->Obj, &x->Obj.ob_pd, &s_list, gensym("_reference"));
+    x->Out = outlet_new(&x->Obj, &s_anything);
+    return x;
+}
+
+// ─────────────────────────────────────
+static void dtw_free(dtw *x) {
+    x->Input.~vector();
+    x->Reference.~vector();
+    x->Templates.~vector();
+    x->Frames.~vector();
+    x->Columns.~vector();
+    x->Prev.~vector();
+    x->Cur.~vector();
+    x->Cost.~vector();
+    x->Step.~vector();
+    x->Upper.~vector();
+    x->Lower.~vector();
+    x->Bounds.~vector();
+}
+
+// ─────────────────────────────────────
+void dtw_setup(void) {
+    Dtw = class_new(gensym("dtw"), (t_newmethod)dtw_new, (t_method)dtw_free, sizeof(dtw), 0,
+                    A_GIMME, 0);
+    class_addlist(Dtw, (t_method)dtw_list);
+    class_addmethod(Dtw, (t_method)dtw_reference, gensym("_reference"), A_GIMME, 0);
+    class_addmethod(Dtw, (t_method)dtw_templates, gensym("templates"), A_GIMME, 0);
+    class_addmethod(Dtw, (t_method)dtw_match, gensym("match"), A_GIMME, 0);
+    class_addmethod(Dtw, (t_method)dtw_band, gensym("band"), A_FLOAT, 0);
+    class_addmethod(Dtw, (t_method)dtw_dim, gensym("dim"), A_FLOAT, 0);
+}
@@ -1,62 +1,475 @@
+#include <algorithm>
 #include <m_pd.h>
 #include <math.h>
+#include <new>
+#include <unordered_map>
 #include <vector>
-#include <map>
+
+#include "xlab-spectrum.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Shannon entropy, normalized to     │
+// │  0..1.                              │
+// │  [entropy]   of a list, counting    │
+// │              equal values or, with  │
+// │              bins > 0, a histogram  │
+// │              over range (or the     │
+// │              min/max of the list)   │
+// │              stream <n> makes each  │
+// │              float update the       │
+// │              entropy of the last n  │
+// │              floats in O(1)         │
+// │  [entropy~]  of a signal window,    │
+// │              mode histogram uses    │
+// │              the amplitudes, mode   │
+// │              spectral the power     │
+// │              spectrum and mode      │
+// │              flatness outputs the   │
+// │              spectral flatness      │
+// ╰─────────────────────────────────────╯
 
 static t_class *Entropy;
 
+enum { ENTROPY_HISTOGRAM, ENTROPY_SPECTRAL, ENTROPY_FLATNESS };
+
 // ─────────────────────────────────────
 class EntropyObj {
   public:
     t_object obj;
+    t_sample sample;
     t_outlet *out;
+
+    // histogram, bins 0 counts equal values (list only)
+    int bins;
+    t_float lo;
+    t_float hi;
+    bool autorange;
+    std::vector<int> counts;
+    std::vector<int> listcounts;
+    std::vector<float> values;
+
+    // stream mode, sum of c*log2(c) over the classes is updated per float
+    int stream;
+    int head;
+    int filled;
+    int updates;
+    double clogc;
+    std::vector<float> history;
+    std::vector<double> clogctable;
+    std::unordered_map<float, int> seen;
+
+    // entropy~, the window is kept as raw samples so the bins can change
+    bool realtime;
+    int mode;
+    int size;
+    int hop;
+    int write;
+    int countdown;
+    std::vector<t_sample> ring;
+    xlab_spectrum *spectrum;
+    t_clock *clock;
+    t_float value;
 };
 
+// ─────────────────────────────────────
+static inline int entropy_bin(EntropyObj *x, float v, float scale) {
+    int b = (int)((v - x->lo) * scale);
+    return b < 0 ? 0 : (b >= x->bins ? x->bins - 1 : b);
+}
+
+// ─────────────────────────────────────
+// normalized by the largest entropy n values can have in `classes` classes
+static double entropy_counts(const int *counts, int classes, int n) {
+    double h = 0.0;
+    for (int i = 0; i < classes; i++) {
+        if (counts[i] > 0) {
+            double prob = (double)counts[i] / n;
+            h -= prob * log2(prob);
+        }
+    }
+    int maxclasses = std::min(classes, n);
+    return maxclasses > 1 ? h / log2(maxclasses) : 0.0;
+}
 
 // ─────────────────────────────────────
 static void entropy_list(EntropyObj *x, t_symbol *s, int argc, t_atom *argv) {
     if (argc == 0) {
-        post("[entropy_list] Lista vazia, entropia = 0");
         outlet_float(x->out, 0.0);
         return;
     }
-    
-    std::map<float, int> frequencias;
-    int totalElementos = argc;
-    
-    // Contar frequência de cada número
+    x->values.resize(argc);
     for (int i = 0; i < argc; i++) {
-        float number = atom_getfloat(argv + i);
-        frequencias[number]++;
+        x->values[i] = atom_getfloat(argv + i);
     }
-    
-    // Calcular entropia
-    double entropia = 0.0;
-    for (const auto& [valor, freq] : frequencias) {
-        double prob = static_cast<double>(freq) / totalElementos;
-        entropia -= prob * log2(prob);
+
+    // equal values, sorted runs instead of a map
+    if (x->bins == 0) {
+        std::sort(x->values.begin(), x->values.end());
+        double h = 0.0;
+        for (int i = 0; i < argc;) {
+            int j = i + 1;
+            while (j < argc && x->values[j] == x->values[i]) {
+                j++;
+            }
+            double prob = (double)(j - i) / argc;
+            h -= prob * log2(prob);
+            i = j;
+        }
+        outlet_float(x->out, argc > 1 ? h / log2(argc) : 0.0);
+        return;
+    }
+
+    if (x->autorange) {
+        auto [min, max] = std::minmax_element(x->values.begin(), x->values.end());
+        x->lo = *min;
+        x->hi = *max;
+    }
+    // own counts, the stream keeps its classes in counts between floats
+    float scale = x->hi > x->lo ? x->bins / (x->hi - x->lo) : 0;
+    x->listcounts.assign(x->bins, 0);
+    for (int i = 0; i < argc; i++) {
+        x->listcounts[entropy_bin(x, x->values[i], scale)]++;
+    }
+    outlet_float(x->out, entropy_counts(x->listcounts.data(), x->bins, argc));
+}
+
+// ─────────────────────────────────────
+// stream mode key of a value, its bin or the value itself
+static inline float entropy_key(EntropyObj *x, float v) {
+    if (x->bins == 0) {
+        return v;
+    }
+    float scale = x->hi > x->lo ? x->bins / (x->hi - x->lo) : 0;
+    return entropy_bin(x, v, scale);
+}
+
+// ─────────────────────────────────────
+// changes the count of a class by d (+1 or -1) and updates clogc
+static inline void entropy_count(EntropyObj *x, float key, int d) {
+    int *c;
+    if (x->bins > 0) {
+        c = &x->counts[(int)key];
+    } else {
+        c = &x->seen[key];
+    }
+    x->clogc += x->clogctable[*c + d] - x->clogctable[*c];
+    *c += d;
+    if (*c == 0 && x->bins == 0) {
+        x->seen.erase(key);
+    }
+}
+
+// ─────────────────────────────────────
+static void entropy_streamreset(EntropyObj *x) {
+    x->head = 0;
+    x->filled = 0;
+    x->updates = 0;
+    x->clogc = 0;
+    x->seen.clear();
+    std::fill(x->counts.begin(), x->counts.end(), 0);
+}
+
+// ─────────────────────────────────────
+// stream <n>, each float is added to the last n ones, 0 goes back to lists
+static void entropy_stream(EntropyObj *x, t_floatarg f) {
+    int n = f > 0 ? f : 0;
+    if (x->realtime) {
+        pd_error(x, "[entropy~] stream is only for entropy");
+        return;
+    } else if (n > 0 && x->bins > 0 && x->autorange) {
+        pd_error(x, "[entropy] stream with bins needs a range");
+        return;
+    }
+    x->stream = n;
+    x->history.assign(n, 0);
+    x->clogctable.resize(n + 1);
+    for (int c = 0; c <= n; c++) {
+        x->clogctable[c] = c > 0 ? c * log2((double)c) : 0.0;
+    }
+    x->seen.reserve(n);
+    entropy_streamreset(x);
+}
+
+// ─────────────────────────────────────
+static void entropy_float(EntropyObj *x, t_floatarg f) {
+    if (x->realtime) {
+        x->sample = f;
+        return;
+    } else if (x->stream == 0) {
+        t_atom a;
+        SETFLOAT(&a, f);
+        entropy_list(x, &s_list, 1, &a);
+        return;
+    }
+
+    float key = entropy_key(x, f);
+    if (x->filled == x->stream) {
+        entropy_count(x, x->history[x->head], -1);
+    } else {
+        x->filled++;
+    }
+    entropy_count(x, key, +1);
+    x->history[x->head] = key;
+    x->head = (x->head + 1) % x->stream;
+
+    // the running sum only drifts by rounding, refresh it once per window
+    if (++x->updates >= x->stream) {
+        x->updates = 0;
+        x->clogc = 0;
+        if (x->bins > 0) {
+            for (int c : x->counts) {
+                x->clogc += x->clogctable[c];
+            }
+        } else {
+            for (auto &entry : x->seen) {
+                x->clogc += x->clogctable[entry.second];
+            }
+        }
+    }
+
+    // H = log2(N) - sum(c * log2(c)) / N
+    int n = x->filled;
+    int classes = x->bins > 0 ? std::min(x->bins, n) : n;
+    double h = log2((double)n) - x->clogc / n;
+    outlet_float(x->out, classes > 1 ? h / log2(classes) : 0.0);
+}
+
+// ─────────────────────────────────────
+// histogram of the current window
+static void entropy_recount(EntropyObj *x) {
+    std::fill(x->counts.begin(), x->counts.end(), 0);
+    if (x->bins == 0 || x->ring.empty()) {
+        return;
+    }
+    float scale = x->hi > x->lo ? x->bins / (x->hi - x->lo) : 0;
+    for (t_sample v : x->ring) {
+        x->counts[entropy_bin(x, v, scale)]++;
+    }
+}
+
+// ─────────────────────────────────────
+static void entropy_bins(EntropyObj *x, t_floatarg f) {
+    int bins = f > 0 ? f : 0;
+    if (bins == 0 && x->realtime) {
+        pd_error(x, "[entropy~] bins must be at least 1");
+        return;
+    } else if (bins > 0 && x->stream > 0 && x->autorange) {
+        pd_error(x, "[entropy] stream with bins needs a range");
+        return;
+    }
+    x->bins = bins;
+    x->counts.assign(bins, 0);
+    entropy_recount(x);
+    if (x->stream > 0) {
+        entropy_streamreset(x);
+    }
+}
+
+// ─────────────────────────────────────
+// range <lo> <hi>, without args the list objects use the min and max of each list
+static void entropy_range(EntropyObj *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc < 2) {
+        if (x->stream > 0 && x->bins > 0) {
+            pd_error(x, "[entropy] stream with bins needs a range");
+            return;
+        }
+        x->autorange = !x->realtime;
+        return;
+    }
+    t_float lo = atom_getfloat(argv);
+    t_float hi = atom_getfloat(argv + 1);
+    if (hi <= lo) {
+        pd_error(x, "[entropy] range high must be bigger than low");
+        return;
+    }
+    x->lo = lo;
+    x->hi = hi;
+    x->autorange = false;
+    entropy_recount(x);
+    if (x->stream > 0) {
+        entropy_streamreset(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void entropy_window(EntropyObj *x, t_floatarg size, t_floatarg hop) {
+    if (!x->realtime) {
+        pd_error(x, "[entropy] window is only for entropy~");
+        return;
+    } else if (size < 2 || hop < 0) {
+        pd_error(x, "[entropy~] window must be at least 2 and hop positive");
+        return;
+    }
+    x->size = size;
+    x->hop = hop > 0 ? (int)hop : x->size / 2;
+    x->write = 0;
+    x->countdown = x->hop;
+    x->ring.assign(x->size, 0);
+    entropy_recount(x);
+    delete x->spectrum;
+    x->spectrum = nullptr;
+    if (x->mode != ENTROPY_HISTOGRAM) {
+        x->spectrum = new xlab_spectrum(x->size, x->hop, xlab_spectrum::HANN, true);
+    }
+}
+
+// ─────────────────────────────────────
+static void entropy_mode(EntropyObj *x, t_symbol *s) {
+    if (!x->realtime) {
+        pd_error(x, "[entropy] mode is only for entropy~");
+        return;
+    } else if (s == gensym("histogram")) {
+        x->mode = ENTROPY_HISTOGRAM;
+    } else if (s == gensym("spectral")) {
+        x->mode = ENTROPY_SPECTRAL;
+    } else if (s == gensym("flatness")) {
+        x->mode = ENTROPY_FLATNESS;
+    } else {
+        pd_error(x, "[entropy~] mode must be histogram, spectral or flatness");
+        return;
+    }
+    entropy_window(x, x->size, x->hop);
+}
+
+// ─────────────────────────────────────
+static double entropy_spectrum(EntropyObj *x) {
+    const float *power = x->spectrum->MagP;
+    int bins = x->spectrum->Bins;
+    double sum = 0.0;
+    for (int k = 0; k < bins; k++) {
+        sum += power[k];
+    }
+    if (sum <= 0) {
+        return 0.0;
+    }
+
+    if (x->mode == ENTROPY_FLATNESS) {
+        // geometric mean over arithmetic mean, silent bins floored to keep the log finite
+        double logsum = 0.0;
+        for (int k = 0; k < bins; k++) {
+            logsum += log(power[k] > 1e-20f ? power[k] : 1e-20f);
+        }
+        return exp(logsum / bins) / (sum / bins);
+    }
+
+    double h = 0.0;
+    for (int k = 0; k < bins; k++) {
+        if (power[k] > 0) {
+            double prob = power[k] / sum;
+            h -= prob * log2(prob);
+        }
+    }
+    return h / log2(bins);
+}
+
+// ─────────────────────────────────────
+static void entropy_tick(EntropyObj *x) { outlet_float(x->out, x->value); }
+
+// ─────────────────────────────────────
+static void entropy_bang(EntropyObj *x) { outlet_float(x->out, x->value); }
+
+// ─────────────────────────────────────
+static t_int *entropy_perform(t_int *w) {
+    EntropyObj *x = (EntropyObj *)(w[1]);
+    const t_sample *in = (t_sample *)(w[2]);
+    t_sample *out = (t_sample *)(w[3]);
+    int n = (int)(w[4]);
+
+    bool ready = false;
+    if (x->mode == ENTROPY_HISTOGRAM) {
+        // the sample leaving the window is taken out of its bin
+        float scale = x->hi > x->lo ? x->bins / (x->hi - x->lo) : 0;
+        int *counts = x->counts.data();
+        t_sample *ring = x->ring.data();
+        for (int i = 0; i < n; i++) {
+            counts[entropy_bin(x, ring[x->write], scale)]--;
+            counts[entropy_bin(x, in[i], scale)]++;
+            ring[x->write] = in[i];
+            if (++x->write == x->size) {
+                x->write = 0;
+            }
+        }
+        x->countdown -= n;
+        if (x->countdown <= 0) {
+            while (x->countdown <= 0) {
+                x->countdown += x->hop;
+            }
+            x->value = entropy_counts(counts, x->bins, x->size);
+            ready = true;
+        }
+    } else if (x->spectrum->push(in, nullptr, n)) {
+        x->value = entropy_spectrum(x);
+        ready = true;
+    }
+
+    t_sample value = x->value;
+    for (int i = 0; i < n; i++) {
+        out[i] = value;
+    }
+    if (ready) {
+        clock_delay(x->clock, 0);
+    }
+    return (w + 5);
+}
+
+// ─────────────────────────────────────
+static void entropy_dsp(EntropyObj *x, t_signal **sp) {
+    if (x->realtime) {
+        dsp_add(entropy_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
     }
-    
-    // Normalizar entre 0 e 1
-    double entropiaMax = log2(totalElementos);
-    double entropiaNormalizada = (totalElementos > 1) ? entropia / entropiaMax : 0.0;
-    
-    // Enviar a entropia normalizada como saída do objeto
-    outlet_float(x->out, entropiaNormalizada);
 }
 
 // ─────────────────────────────────────
 static void *entropy_new(t_symbol *s, int argc, t_atom *argv) {
     EntropyObj *x = (EntropyObj *)pd_new(Entropy);
-    x->out = outlet_new(&x->obj, &s_anything);
+    // pd_new only zeroes the memory, unlike the vectors the map needs its constructor
+    new (&x->seen) std::unordered_map<float, int>();
+    x->realtime = s == gensym("entropy~");
+    if (x->realtime) {
+        // [entropy~ <window> <hop>], histogram of 32 bins over -1..1
+        x->lo = -1;
+        x->hi = 1;
+        x->mode = ENTROPY_HISTOGRAM;
+        entropy_bins(x, 32);
+        entropy_window(x, argc > 0 ? atom_getfloat(argv) : 1024,
+                       argc > 1 ? atom_getfloat(argv + 1) : 0);
+        outlet_new(&x->obj, &s_signal);
+        x->clock = clock_new(x, (t_method)entropy_tick);
+    } else {
+        x->autorange = true;
+    }
+    x->out = outlet_new(&x->obj, &s_float);
     return (x);
 }
 
+// ─────────────────────────────────────
+static void entropy_free(EntropyObj *x) {
+    if (x->clock) {
+        clock_free(x->clock);
+    }
+    delete x->spectrum;
+    x->counts.~vector();
+    x->listcounts.~vector();
+    x->values.~vector();
+    x->ring.~vector();
+    x->history.~vector();
+    x->clogctable.~vector();
+    x->seen.~unordered_map();
+}
+
 // ─────────────────────────────────────
 void entropy_setup(void) {
-    Entropy = class_new(gensym("entropy"), (t_newmethod)entropy_new, 0, sizeof(EntropyObj),
-                          0, A_GIMME, 0);
+    Entropy = class_new(gensym("entropy"), (t_newmethod)entropy_new, (t_method)entropy_free,
+                        sizeof(EntropyObj), 0, A_GIMME, 0);
     class_addcreator((t_newmethod)entropy_new, gensym("entropy~"), A_GIMME, 0);
+    CLASS_MAINSIGNALIN(Entropy, EntropyObj, sample);
+    class_addmethod(Entropy, (t_method)entropy_dsp, gensym("dsp"), A_CANT, 0);
     class_addlist(Entropy, entropy_list);
+    class_addfloat(Entropy, entropy_float);
+    class_addbang(Entropy, entropy_bang);
+    class_addmethod(Entropy, (t_method)entropy_bins, gensym("bins"), A_FLOAT, 0);
+    class_addmethod(Entropy, (t_method)entropy_range, gensym("range"), A_GIMME, 0);
+    class_addmethod(Entropy, (t_method)entropy_window, gensym("window"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(Entropy, (t_method)entropy_mode, gensym("mode"), A_SYMBOL, 0);
+    class_addmethod(Entropy, (t_method)entropy_stream, gensym("stream"), A_FLOAT, 0);
 }
-
@@ -1,187 +1,862 @@
+#include <algorithm>
+#include <atomic>
+#include <limits.h>
 #include <m_pd.h>
-
 #include <math.h>
+#include <new>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
-static t_class *Euclidean;
+#include "xlab-divergence.hpp"
+#include "xlab-hnsw.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Euclidean distance between two     │
+// │  vectors, sqrt(sum (P - Q)^2).      │
+// │                                     │
+// │  [euclidean] also keeps a corpus of │
+// │  feature vectors for k-nearest      │
+// │  neighbour search:                  │
+// │    insert <v1> ... <vd>             │
+// │    load <array> <d>                 │
+// │    nearest <k> <v1> ... <vd>        │
+// │    clear                            │
+// │  nearest outputs [indices ...( and  │
+// │  [distances ...(, closest first.    │
+// │                                     │
+// │  For large corpora an approximate   │
+// │  HNSW index is built in background: │
+// │    index [M] [efConstruction]       │
+// │    ef <n>  (recall/speed, def. 64)  │
+// │    write <file>                     │
+// │    read <file>                      │
+// │  Once [indexed <rows>( comes out,   │
+// │  nearest uses the index. Until then │
+// │  insert is refused, and load, clear │
+// │  and read abandon the build. read   │
+// │  loads the corpus and its index     │
+// │  together.                          │
+// │                                     │
+// │  Pairwise distances of all rows:    │
+// │    matrix <array> [metric] [upper]  │
+// │    mahalanobis <covariance array>   │
+// │  metric is euclidean, cosine,       │
+// │  manhattan, chebyshev or            │
+// │  mahalanobis. The array gets N x N  │
+// │  values, or with upper the N(N-1)/2 │
+// │  above the diagonal row by row, and │
+// │  [matrix N( comes out when done.    │
+// │  Until then insert and mahalanobis  │
+// │  are refused, and load, clear and   │
+// │  read abandon the matrix.           │
+// ╰─────────────────────────────────────╯
 
 // ─────────────────────────────────────
-class EntropyObj {
-  public:
-    EntropyObj() {};
+struct euclidean_distance {
+    static constexpr const char *name = "euclidean";
+    static constexpr int terms = 1;
+    static constexpr bool prescale = true;
+    static constexpr bool distribution = false;
+    static constexpr bool alpha = false;
+    static constexpr bool listrms = true;
+    static constexpr bool legacyargs = false;
 
-    t_object obj;
-    t_sample Sample;
+    // ─────────────────────────────────────
+    static void exact(const xlab_divergence_params &par, double p, double q, double *acc) {
+        double d = p - q;
+        acc[0] += d * d;
+    }
 
-    float Alpha;
+    // ─────────────────────────────────────
+    static void fast(const xlab_divergence_params &par, xlab_vfloat p, xlab_vfloat q,
+                     xlab_vfloat *acc) {
+        xlab_vfloat d = xlab_vsub(p, q);
+        acc[0] = xlab_vadd(acc[0], xlab_vmul(d, d));
+    }
 
-    bool RealTime;
-    bool Normalize;
-    bool Exp;
+    // ─────────────────────────────────────
+    static double result(const xlab_divergence_params &par, const double *acc, double s1,
+                         double s2, int n) {
+        return sqrt(acc[0]);
+    }
+};
 
-    std::vector<float> array1;
+// ─────────────────────────────────────
+// Rows are padded to whole 4-float vectors, so each row starts 16-byte aligned
+// and the padding lanes are 0 in the corpus and in the query. Big corpora are searched on a
+// worker thread polled by a clock, the result comes out a few ms later.
+class euclidean : public xlab_divergence<euclidean_distance> {
+  public:
+    int Dim;
+    int Stride;
+    int Rows;
+    std::vector<float> Corpus;
 
-    t_clock *Clock;
+    std::vector<float> Query;
+    int K;
+    std::vector<std::pair<float, int>> Nearest;
 
-    t_inlet *In2;
-    t_outlet *out;
+    std::thread Worker;
+    std::atomic<bool> Done;
+    bool Busy;
+    bool HasPending;
+    std::vector<float> PendingQuery;
+    int PendingK;
+    t_clock *Poll;
+    std::vector<t_atom> Atoms;
 
-    t_symbol *Q;
-    t_symbol *P;
+    // approximate index, inserts keep it up to date, load and clear drop it
+    xlab_hnsw *Index;
+    xlab_hnsw *Building;
+    std::thread Builder;
+    std::atomic<bool> Built;
+    std::atomic<bool> Cancel;
+    t_clock *BuildPoll;
+    int Ef;
 
-    t_float distance;
+    // distance matrix, see euclidean_matrix
+    int Metric;
+    bool Upper;
+    xlab_array Target;
+    std::vector<double> Cholesky;
+    std::vector<float> Whitened;
+    std::vector<float> Norms;
+    std::vector<float> Matrix;
+    std::vector<std::pair<int, int>> Tiles;
+    std::atomic<int> NextTile;
+    std::thread MatrixWorker;
+    std::atomic<bool> MatrixDone;
+    std::atomic<bool> MatrixCancel;
+    bool Computing;
+    t_clock *MatrixPoll;
 };
 
+enum euclidean_metric { METRIC_EUCLIDEAN, METRIC_COSINE, METRIC_MANHATTAN, METRIC_CHEBYSHEV,
+                        METRIC_MAHALANOBIS };
+
+static t_class *&Euclidean = xlab_divergence<euclidean_distance>::Class;
+
+// ─────────────────────────────────────
+static inline float euclidean_row(const float *row, const float *query, int stride) {
+    xlab_vfloat acc = xlab_vdup(0);
+    for (int j = 0; j < stride; j += 4) {
+        xlab_vfloat d = xlab_vsub(xlab_vload(row + j), xlab_vload(query + j));
+        acc = xlab_vadd(acc, xlab_vmul(d, d));
+    }
+    return xlab_vsum(acc);
+}
+
+// ─────────────────────────────────────
+// k smallest squared distances with a max-heap of k entries, sorted at the end
+static void euclidean_search(euclidean *x) {
+    auto &heap = x->Nearest;
+    heap.clear();
+    for (int r = 0; r < x->Rows; r++) {
+        float d = euclidean_row(&x->Corpus[(size_t)r * x->Stride], x->Query.data(), x->Stride);
+        if ((int)heap.size() < x->K) {
+            heap.push_back({d, r});
+            std::push_heap(heap.begin(), heap.end());
+        } else if (d < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = {d, r};
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end());
+}
+
+// ─────────────────────────────────────
+static void euclidean_output(euclidean *x) {
+    int k = x->Nearest.size();
+    x->Atoms.resize(k);
+    for (int i = 0; i < k; i++) {
+        SETFLOAT(&x->Atoms[i], x->Nearest[i].second);
+    }
+    outlet_anything(x->Out, gensym("indices"), k, x->Atoms.data());
+    for (int i = 0; i < k; i++) {
+        SETFLOAT(&x->Atoms[i], sqrtf(x->Nearest[i].first));
+    }
+    outlet_anything(x->Out, gensym("distances"), k, x->Atoms.data());
+}
+
+// ─────────────────────────────────────
+static void euclidean_start(euclidean *x) {
+    x->Busy = true;
+    x->Done = false;
+    x->Worker = std::thread([x] {
+        euclidean_search(x);
+        x->Done = true;
+    });
+    clock_delay(x->Poll, 1);
+}
+
+// ─────────────────────────────────────
+static void euclidean_poll(euclidean *x) {
+    if (!x->Done) {
+        clock_delay(x->Poll, 1);
+        return;
+    }
+    x->Worker.join();
+    x->Busy = false;
+    euclidean_output(x);
+    if (x->HasPending) {
+        // only the latest query that arrived meanwhile is answered
+        x->HasPending = false;
+        std::swap(x->Query, x->PendingQuery);
+        x->K = x->PendingK;
+        euclidean_start(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void euclidean_indexed(euclidean *x) {
+    x->Builder.join();
+    delete x->Index;
+    x->Index = x->Building;
+    x->Building = nullptr;
+    t_atom a;
+    SETFLOAT(&a, x->Index->Count);
+    outlet_anything(x->Out, gensym("indexed"), 1, &a);
+}
+
+// ─────────────────────────────────────
+static void euclidean_buildpoll(euclidean *x) {
+    if (!x->Built) {
+        clock_delay(x->BuildPoll, 10);
+        return;
+    }
+    euclidean_indexed(x);
+}
+
+// ─────────────────────────────────────
+// the builder checks Cancel between insertions, so this returns within one of them
+static void euclidean_cancelbuild(euclidean *x) {
+    if (!x->Building) {
+        return;
+    }
+    clock_unset(x->BuildPoll);
+    x->Cancel = true;
+    x->Builder.join();
+    delete x->Building;
+    x->Building = nullptr;
+}
+
 // ─────────────────────────────────────
-static void euclidean_bang(EntropyObj *x) {
-    t_float RenyiDiv = 0.0;
-    t_garray *Arr1 = (t_garray *)pd_findbyclass(x->P, garray_class);
-    t_garray *Arr2 = (t_garray *)pd_findbyclass(x->Q, garray_class);
-    if (!Arr1 || !Arr2) {
-        pd_error(x, "[renyi] couldn't find some table");
+// the workers check MatrixCancel before each tile, the matrix is not delivered
+static void euclidean_cancelmatrix(euclidean *x) {
+    if (!x->Computing) {
         return;
     }
-    t_word *Arr1Vec;
-    int Arr1Size;
-    garray_getfloatwords(Arr1, &Arr1Size, &Arr1Vec);
+    clock_unset(x->MatrixPoll);
+    x->MatrixCancel = true;
+    x->MatrixWorker.join();
+    x->Computing = false;
+}
+
+// ─────────────────────────────────────
+// the corpus can't change under a running search, builds and matrices are
+// cancelled instead since they can take minutes
+static void euclidean_wait(euclidean *x) {
+    if (x->Busy) {
+        x->Worker.join();
+        x->Busy = false;
+        x->HasPending = false;
+        clock_unset(x->Poll);
+        euclidean_output(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void euclidean_dropindex(euclidean *x) {
+    delete x->Index;
+    x->Index = nullptr;
+}
 
-    t_word *Arr2Vec;
-    int Arr2Size;
-    garray_getfloatwords(Arr2, &Arr2Size, &Arr2Vec);
-    if (Arr1Size != Arr2Size) {
-        pd_error(x, "[renyi] tables must have the same size");
+// ─────────────────────────────────────
+static bool euclidean_dimension(euclidean *x, int d) {
+    if (x->Rows == 0) {
+        x->Dim = d;
+        x->Stride = (d + 3) / 4 * 4;
+    } else if (d != x->Dim) {
+        pd_error(x, "[euclidean] corpus vectors have %d values, got %d", x->Dim, d);
+        return false;
+    }
+    return d > 0;
+}
+
+// ─────────────────────────────────────
+static void euclidean_setrow(float *row, int stride, int argc, t_atom *argv) {
+    for (int j = 0; j < stride; j++) {
+        row[j] = j < argc ? atom_getfloat(argv + j) : 0;
+    }
+}
+
+// ─────────────────────────────────────
+// insert <v1> ... <vd> or insert <array>, the whole array as one row
+static void euclidean_insert(euclidean *x, t_symbol *s, int argc, t_atom *argv) {
+    if (x->Building) {
+        pd_error(x, "[euclidean] index is being built, insert after [indexed(");
+        return;
+    } else if (x->Computing) {
+        pd_error(x, "[euclidean] matrix is being computed, insert after [matrix(");
         return;
     }
-    if (x->Normalize) {
-        float Sum1 = 0.0;
-        float Sum2 = 0.0;
-        for (int i = 0; i < Arr1Size; i++) {
-            Sum1 += Arr1Vec[i].w_float;
-            Sum2 += Arr2Vec[i].w_float;
+    euclidean_wait(x);
+    xlab_array arr;
+    if (argc == 1 && argv[0].a_type == A_SYMBOL) {
+        arr.set(atom_getsymbol(argv));
+        if (!arr.get(x, "euclidean")) {
+            return;
         }
-        for (int i = 0; i < Arr1Size; i++) {
-            Arr1Vec[i].w_float /= Sum1;
-            Arr2Vec[i].w_float /= Sum2;
+        argc = arr.size;
+    }
+    if (!euclidean_dimension(x, argc)) {
+        return;
+    }
+    x->Corpus.resize((size_t)(x->Rows + 1) * x->Stride);
+    float *row = &x->Corpus[(size_t)x->Rows * x->Stride];
+    if (arr.name) {
+        for (int j = 0; j < x->Stride; j++) {
+            row[j] = j < argc ? arr.vec[j].w_float : 0;
         }
+    } else {
+        euclidean_setrow(row, x->Stride, argc, argv);
+    }
+    x->Rows++;
+    if (x->Index) {
+        x->Index->insert(x->Corpus.data());
     }
+}
+
+// ─────────────────────────────────────
+// load <array> <d>, the whole array as rows of d values
+static void euclidean_load(euclidean *x, t_symbol *s, t_float f) {
+    int d = f;
+    xlab_array arr;
+    arr.set(s);
+    if (!arr.get(x, "euclidean")) {
+        return;
+    } else if (d < 1 || arr.size % d != 0) {
+        pd_error(x, "[euclidean] '%s' size must be a multiple of %d", s->s_name, d);
+        return;
+    }
+    euclidean_cancelbuild(x);
+    euclidean_cancelmatrix(x);
+    euclidean_wait(x);
+    euclidean_dropindex(x);
+    x->Rows = 0;
+    euclidean_dimension(x, d);
+    x->Rows = arr.size / d;
+    x->Corpus.assign((size_t)x->Rows * x->Stride, 0);
+    for (int r = 0; r < x->Rows; r++) {
+        float *row = &x->Corpus[(size_t)r * x->Stride];
+        for (int j = 0; j < d; j++) {
+            row[j] = arr.vec[r * d + j].w_float;
+        }
+    }
+}
 
-    for (int i = 0; i < Arr1Size; i++) {
-        float IVec1 = Arr1Vec[i].w_float;
-        float IVec2 = Arr2Vec[i].w_float;
-        if (IVec1 > 0 && IVec2 > 0) {
-            RenyiDiv += pow(IVec1, x->Alpha) * pow(IVec2, 1 - x->Alpha);
+// ─────────────────────────────────────
+static void euclidean_clear(euclidean *x) {
+    euclidean_cancelbuild(x);
+    euclidean_cancelmatrix(x);
+    euclidean_wait(x);
+    euclidean_dropindex(x);
+    x->Rows = 0;
+    x->Corpus.clear();
+}
+
+// ─────────────────────────────────────
+// index [M] [efConstruction], M links per node (default 16), efConstruction
+// candidates per insertion (default 200), higher values build slower and
+// give better recall
+static void euclidean_index(euclidean *x, t_float m, t_float efc) {
+    if (x->Rows == 0) {
+        pd_error(x, "[euclidean] corpus is empty");
+        return;
+    }
+    euclidean_cancelbuild(x);
+    euclidean_wait(x);
+    x->Building = new xlab_hnsw;
+    x->Building->init(x->Dim, x->Stride, m > 0 ? m : 16, efc > 0 ? efc : 200);
+    x->Built = false;
+    x->Cancel = false;
+    x->Builder = std::thread([x, rows = x->Rows] {
+        for (int r = 0; r < rows && !x->Cancel; r++) {
+            x->Building->insert(x->Corpus.data());
         }
+        x->Built = true;
+    });
+    if (!x->BuildPoll) {
+        x->BuildPoll = clock_new(x, (t_method)euclidean_buildpoll);
     }
+    clock_delay(x->BuildPoll, 10);
+}
 
-    RenyiDiv = log(RenyiDiv) / (x->Alpha - 1.0);
+// ─────────────────────────────────────
+static void euclidean_ef(euclidean *x, t_float f) { x->Ef = f < 1 ? 1 : f; }
 
-    // Set the diversity value and output it
-    x->distance = RenyiDiv;
+// ─────────────────────────────────────
+static void euclidean_write(euclidean *x, t_symbol *s) {
+    if (x->Building) {
+        pd_error(x, "[euclidean] index is being built, write after [indexed(");
+        return;
+    }
+    euclidean_wait(x);
+    if (!x->Index) {
+        pd_error(x, "[euclidean] no index to write, send 'index' first");
+        return;
+    }
+    char path[MAXPDSTRING];
+    canvas_makefilename(x->Canvas, s->s_name, path, MAXPDSTRING);
+    if (!x->Index->save(path, x->Corpus.data())) {
+        pd_error(x, "[euclidean] can't write '%s'", path);
+    }
+}
 
-    outlet_float(x->out, x->distance);
+// ─────────────────────────────────────
+static void euclidean_read(euclidean *x, t_symbol *s) {
+    char path[MAXPDSTRING];
+    canvas_makefilename(x->Canvas, s->s_name, path, MAXPDSTRING);
+    xlab_hnsw *index = new xlab_hnsw;
+    std::vector<float> corpus;
+    if (!index->load(path, corpus)) {
+        pd_error(x, "[euclidean] can't read index '%s'", path);
+        delete index;
+        return;
+    }
+    euclidean_cancelbuild(x);
+    euclidean_cancelmatrix(x);
+    euclidean_wait(x);
+    delete x->Index;
+    x->Index = index;
+    x->Corpus.swap(corpus);
+    x->Dim = index->Dim;
+    x->Stride = index->Stride;
+    x->Rows = index->Count;
+    t_atom a;
+    SETFLOAT(&a, x->Rows);
+    outlet_anything(x->Out, gensym("indexed"), 1, &a);
 }
 
 // ─────────────────────────────────────
-static void euclidean_list(EntropyObj *x, t_symbol *s, int argc, t_atom *argv) {
-    t_float distance = 0.0;
-    int size = x->array1.size();
-    if (size != argc) {
-        pd_error(x, "[euclidean] list must have the same size");
+static void euclidean_nearest(euclidean *x, t_symbol *s, int argc, t_atom *argv) {
+    if (x->Rows == 0) {
+        pd_error(x, "[euclidean] corpus is empty");
+        return;
+    } else if (argc - 1 != x->Dim) {
+        pd_error(x, "[euclidean] nearest needs k and %d values", x->Dim);
         return;
     }
+    int k = atom_getfloat(argv);
+    k = std::clamp(k, 1, x->Rows);
 
-    // Calcula a soma dos quadrados das diferenças
-    for (int i = 0; i < argc; i++) {
-        float number = atom_getfloat(argv + i);
-        distance += pow(number - x->array1[i], 2);
+    if (x->Busy) {
+        x->PendingQuery.resize(x->Stride);
+        euclidean_setrow(x->PendingQuery.data(), x->Stride, argc - 1, argv + 1);
+        x->PendingK = k;
+        x->HasPending = true;
+        return;
     }
+    x->Query.resize(x->Stride);
+    euclidean_setrow(x->Query.data(), x->Stride, argc - 1, argv + 1);
+    x->K = k;
 
-    // Distância euclidiana
-    t_float euclidean_distance = sqrt(distance);
-    // Normaliza dividindo pela distância máxima possível sqrt(n)
-    t_float normalized_distance = euclidean_distance / sqrt(argc);
+    if (x->Index) {
+        x->Index->search(x->Corpus.data(), x->Query.data(), k, x->Ef ? x->Ef : 64, x->Nearest);
+        euclidean_output(x);
+        return;
+    }
 
-    x->distance = normalized_distance;
-    outlet_float(x->out, normalized_distance);
+    // small corpora answer right away
+    if ((long)x->Rows * x->Dim < 65536) {
+        euclidean_search(x);
+        euclidean_output(x);
+        return;
+    }
+    if (!x->Poll) {
+        x->Poll = clock_new(x, (t_method)euclidean_poll);
+    }
+    euclidean_start(x);
 }
 
 // ─────────────────────────────────────
-static void euclidean_storelist(EntropyObj *x, t_symbol *s, int argc, t_atom *argv) {
-    x->array1.clear();
-    for (int i = 0; i < argc; i++) {
-        x->array1.push_back(atom_getfloat(argv + i));
+// Distance kernels over two padded rows, na and nb are the row norms (used by
+// cosine only). Mahalanobis rows are whitened first, so it is euclidean here.
+struct metric_euclidean {
+    static float distance(const float *a, const float *b, int stride, float na, float nb) {
+        return sqrtf(euclidean_row(a, b, stride));
+    }
+};
+
+// ─────────────────────────────────────
+struct metric_cosine {
+    static float distance(const float *a, const float *b, int stride, float na, float nb) {
+        xlab_vfloat acc = xlab_vdup(0);
+        for (int j = 0; j < stride; j += 4) {
+            acc = xlab_vadd(acc, xlab_vmul(xlab_vload(a + j), xlab_vload(b + j)));
+        }
+        if (na == 0 || nb == 0) {
+            return 1;
+        }
+        return 1 - xlab_vsum(acc) / (na * nb);
+    }
+};
+
+// ─────────────────────────────────────
+struct metric_manhattan {
+    static float distance(const float *a, const float *b, int stride, float na, float nb) {
+        xlab_vfloat acc = xlab_vdup(0);
+        for (int j = 0; j < stride; j += 4) {
+            acc = xlab_vadd(acc, xlab_vabs(xlab_vsub(xlab_vload(a + j), xlab_vload(b + j))));
+        }
+        return xlab_vsum(acc);
+    }
+};
+
+// ─────────────────────────────────────
+struct metric_chebyshev {
+    static float distance(const float *a, const float *b, int stride, float na, float nb) {
+        xlab_vfloat acc = xlab_vdup(0);
+        for (int j = 0; j < stride; j += 4) {
+            acc = xlab_vmax(acc, xlab_vabs(xlab_vsub(xlab_vload(a + j), xlab_vload(b + j))));
+        }
+        float lanes[4];
+        xlab_vstore(lanes, acc);
+        return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+};
+
+// ─────────────────────────────────────
+// Tiles of 32 x 32 rows keep both blocks in L1/L2 while every pair is visited,
+// threads take the next tile of the upper triangle from an atomic counter.
+#define EUCLIDEAN_TILE 32
+
+template <typename Metric> static void euclidean_tiles(euclidean *x, const float *rows) {
+    int n = x->Rows;
+    int stride = x->Stride;
+    const float *norms = x->Norms.data();
+    float *m = x->Matrix.data();
+    int tiles = x->Tiles.size();
+    for (int t = x->NextTile++; t < tiles && !x->MatrixCancel; t = x->NextTile++) {
+        int i0 = x->Tiles[t].first;
+        int j0 = x->Tiles[t].second;
+        int i1 = std::min(i0 + EUCLIDEAN_TILE, n);
+        int j1 = std::min(j0 + EUCLIDEAN_TILE, n);
+        for (int i = i0; i < i1; i++) {
+            const float *a = rows + (size_t)i * stride;
+            for (int j = std::max(j0, i + 1); j < j1; j++) {
+                const float *b = rows + (size_t)j * stride;
+                float d = Metric::distance(a, b, stride, norms[i], norms[j]);
+                if (x->Upper) {
+                    m[(size_t)i * n - (size_t)i * (i + 1) / 2 + (j - i - 1)] = d;
+                } else {
+                    m[(size_t)i * n + j] = d;
+                    m[(size_t)j * n + i] = d;
+                }
+            }
+        }
     }
-    return;
 }
 
 // ─────────────────────────────────────
-static void euclidean_tick(EntropyObj *x) {
-    //
-    // outlet_float(x->Out, x->distance);
+// z = L^-1 (v) by forward substitution, for rows first to last
+static void euclidean_whiten(euclidean *x, int first, int last) {
+    int d = x->Dim;
+    const double *L = x->Cholesky.data();
+    std::vector<double> z(d);
+    for (int r = first; r < last; r++) {
+        const float *v = &x->Corpus[(size_t)r * x->Stride];
+        float *w = &x->Whitened[(size_t)r * x->Stride];
+        for (int i = 0; i < d; i++) {
+            double sum = v[i];
+            for (int k = 0; k < i; k++) {
+                sum -= L[i * d + k] * z[k];
+            }
+            z[i] = sum / L[i * d + i];
+            w[i] = z[i];
+        }
+    }
 }
+
 // ─────────────────────────────────────
-static void euclidean_norm(EntropyObj *x, t_floatarg f) {
-    if (f == 1) {
-        x->Normalize = true;
-    } else {
-        x->Normalize = false;
+static void euclidean_norms(euclidean *x, int first, int last) {
+    for (int r = first; r < last; r++) {
+        const float *v = &x->Corpus[(size_t)r * x->Stride];
+        xlab_vfloat acc = xlab_vdup(0);
+        for (int j = 0; j < x->Stride; j += 4) {
+            acc = xlab_vadd(acc, xlab_vmul(xlab_vload(v + j), xlab_vload(v + j)));
+        }
+        x->Norms[r] = sqrtf(xlab_vsum(acc));
     }
-    return;
 }
 
 // ─────────────────────────────────────
-static t_int *euclidean_perform(t_int *w) {
-    EntropyObj *x = (EntropyObj *)(w[1]);
-    t_float *Arr1Vec = (t_float *)(w[2]);
-    t_float *Arr2Vec = (t_float *)(w[3]);
-    int n = (int)(w[4]);
+// per-row pass of one worker before the tiles, norms or whitened rows
+static void euclidean_prepare(euclidean *x, int w, int workers) {
+    int first = (long)x->Rows * w / workers;
+    int last = (long)x->Rows * (w + 1) / workers;
+    switch (x->Metric) {
+    case METRIC_COSINE:
+        euclidean_norms(x, first, last);
+        break;
+    case METRIC_MAHALANOBIS:
+        euclidean_whiten(x, first, last);
+        break;
+    }
+}
 
-    // Initialize the Euclidean distance variable
-    t_float distance = 0.0;
+// ─────────────────────────────────────
+static void euclidean_computematrix(euclidean *x, int workers) {
+    std::vector<std::thread> pool;
+    auto parallel = [&](auto job) {
+        for (int w = 1; w < workers; w++) {
+            pool.emplace_back(job, w);
+        }
+        job(0);
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+        pool.clear();
+    };
+    parallel([x, workers](int w) { euclidean_prepare(x, w, workers); });
+    x->NextTile = 0;
+    parallel([x](int w) {
+        switch (x->Metric) {
+        case METRIC_COSINE:
+            euclidean_tiles<metric_cosine>(x, x->Corpus.data());
+            break;
+        case METRIC_MANHATTAN:
+            euclidean_tiles<metric_manhattan>(x, x->Corpus.data());
+            break;
+        case METRIC_CHEBYSHEV:
+            euclidean_tiles<metric_chebyshev>(x, x->Corpus.data());
+            break;
+        case METRIC_MAHALANOBIS:
+            euclidean_tiles<metric_euclidean>(x, x->Whitened.data());
+            break;
+        default:
+            euclidean_tiles<metric_euclidean>(x, x->Corpus.data());
+        }
+    });
+}
 
-    // Calculate the sum of squared differences
-    for (int i = 0; i < n; i++) {
-        distance += pow(Arr1Vec[i] - Arr2Vec[i], 2);
+// ─────────────────────────────────────
+static void euclidean_delivermatrix(euclidean *x) {
+    x->Computing = false;
+    int size = x->Matrix.size();
+    if (!x->Target.get(x, "euclidean")) {
+        return;
+    } else if (x->Target.size != size && !x->Target.resize(x, "euclidean", size)) {
+        return;
     }
+    for (int i = 0; i < size; i++) {
+        x->Target.vec[i].w_float = x->Matrix[i];
+    }
+    xlab_redraw::request(x->Target);
+    t_atom a;
+    SETFLOAT(&a, x->Rows);
+    outlet_anything(x->Out, gensym("matrix"), 1, &a);
+}
 
-    x->distance = sqrt(distance);
-    clock_delay(x->Clock, 0);
-    return (w + 5);
+// ─────────────────────────────────────
+static void euclidean_matrixpoll(euclidean *x) {
+    if (!x->MatrixDone) {
+        clock_delay(x->MatrixPoll, 5);
+        return;
+    }
+    x->MatrixWorker.join();
+    euclidean_delivermatrix(x);
 }
 
 // ─────────────────────────────────────
-static void euclidean_dsp(EntropyObj *x, t_signal **sp) {
-    if (x->RealTime) {
-        dsp_add(euclidean_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
+// mahalanobis <array>, the d x d covariance matrix of the rows, row by row. It
+// is kept as its Cholesky factor L, distances are euclidean between L^-1 v.
+static void euclidean_mahalanobis(euclidean *x, t_symbol *s) {
+    if (x->Computing) {
+        pd_error(x, "[euclidean] matrix is being computed, send mahalanobis after [matrix(");
+        return;
     }
+    xlab_array arr;
+    arr.set(s);
+    if (!arr.get(x, "euclidean")) {
+        return;
+    }
+    int d = sqrt((double)arr.size) + 0.5;
+    if (d * d != arr.size || d < 1) {
+        pd_error(x, "[euclidean] covariance '%s' must be a square matrix", s->s_name);
+        return;
+    }
+    std::vector<double> L((size_t)d * d, 0.0);
+    for (int i = 0; i < d; i++) {
+        for (int j = 0; j <= i; j++) {
+            double sum = arr.vec[i * d + j].w_float;
+            for (int k = 0; k < j; k++) {
+                sum -= L[i * d + k] * L[j * d + k];
+            }
+            if (i == j) {
+                if (sum <= 0) {
+                    pd_error(x, "[euclidean] covariance '%s' is not positive definite",
+                             s->s_name);
+                    return;
+                }
+                L[i * d + i] = sqrt(sum);
+            } else {
+                L[i * d + j] = sum / L[j * d + j];
+            }
+        }
+    }
+    x->Cholesky.swap(L);
 }
 
 // ─────────────────────────────────────
-static void *euclidean_new(t_symbol *s, int argc, t_atom *argv) {
-    EntropyObj *x = (EntropyObj *)pd_new(Euclidean);
-    bool isSinal = false;
-    std::string method = "euclidean~";
-    if (s->s_name == method) {
-        x->RealTime = true;
+// matrix <array> [metric] [upper], see the header. Corpora with more than 64k
+// value pairs are computed on worker threads and delivered by a clock.
+static void euclidean_matrix(euclidean *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc < 1 || argv[0].a_type != A_SYMBOL) {
+        pd_error(x, "[euclidean] matrix needs a target array");
+        return;
+    } else if (x->Computing) {
+        pd_error(x, "[euclidean] still computing the previous matrix");
+        return;
+    } else if (x->Rows < 2) {
+        pd_error(x, "[euclidean] matrix needs at least 2 corpus rows");
+        return;
+    }
+
+    std::string metric = argc > 1 ? atom_getsymbol(argv + 1)->s_name : "euclidean";
+    if (metric == "euclidean") {
+        x->Metric = METRIC_EUCLIDEAN;
+    } else if (metric == "cosine") {
+        x->Metric = METRIC_COSINE;
+    } else if (metric == "manhattan") {
+        x->Metric = METRIC_MANHATTAN;
+    } else if (metric == "chebyshev") {
+        x->Metric = METRIC_CHEBYSHEV;
+    } else if (metric == "mahalanobis") {
+        if (x->Cholesky.size() != (size_t)x->Dim * x->Dim) {
+            pd_error(x, "[euclidean] mahalanobis needs a %d x %d covariance, send "
+                        "'mahalanobis <array>' first",
+                     x->Dim, x->Dim);
+            return;
+        }
+        x->Metric = METRIC_MAHALANOBIS;
     } else {
-        x->RealTime = false;
-        x->In2 = inlet_new(&x->obj, &x->obj.ob_pd, &s_list, gensym("_storelist"));
+        pd_error(x, "[euclidean] unknown metric '%s'", metric.c_str());
+        return;
+    }
+    x->Upper = argc > 2 && atom_getsymbol(argv + 2) == gensym("upper");
+
+    // Pd array sizes are int
+    int n = x->Rows;
+    size_t size = x->Upper ? (size_t)n * (n - 1) / 2 : (size_t)n * n;
+    if (size > INT_MAX) {
+        pd_error(x, "[euclidean] the matrix of %d rows has more values than an array can hold", n);
+        return;
+    }
+    x->Target.set(atom_getsymbol(argv));
+    x->Matrix.assign(size, 0.0f);
+    x->Norms.assign(n, 0.0f);
+    if (x->Metric == METRIC_MAHALANOBIS) {
+        x->Whitened.assign(x->Corpus.size(), 0.0f);
+    }
+    x->Tiles.clear();
+    for (int i = 0; i < n; i += EUCLIDEAN_TILE) {
+        for (int j = i; j < n; j += EUCLIDEAN_TILE) {
+            x->Tiles.push_back({i, j});
+        }
+    }
+
+    x->Computing = true;
+    x->MatrixCancel = false;
+    if ((long)n * n / 2 * x->Dim < 65536) {
+        euclidean_computematrix(x, 1);
+        euclidean_delivermatrix(x);
+        return;
+    }
+    int workers = std::thread::hardware_concurrency();
+    workers = std::clamp(workers, 1, std::max(1, n / EUCLIDEAN_TILE));
+    x->MatrixDone = false;
+    x->MatrixWorker = std::thread([x, workers] {
+        euclidean_computematrix(x, workers);
+        x->MatrixDone = true;
+    });
+    if (!x->MatrixPoll) {
+        x->MatrixPoll = clock_new(x, (t_method)euclidean_matrixpoll);
+    }
+    clock_delay(x->MatrixPoll, 5);
+}
+
+// ─────────────────────────────────────
+// pd_new only zeroes the memory, the threads and atomics need their constructors
+static void euclidean_construct(xlab_divergence<euclidean_distance> *obj) {
+    euclidean *x = (euclidean *)obj;
+    new (&x->Worker) std::thread();
+    new (&x->Done) std::atomic<bool>(false);
+    new (&x->Builder) std::thread();
+    new (&x->Built) std::atomic<bool>(false);
+    new (&x->Cancel) std::atomic<bool>(false);
+    new (&x->NextTile) std::atomic<int>(0);
+    new (&x->MatrixWorker) std::thread();
+    new (&x->MatrixDone) std::atomic<bool>(false);
+    new (&x->MatrixCancel) std::atomic<bool>(false);
+}
+
+// ─────────────────────────────────────
+static void euclidean_free(euclidean *x) {
+    if (x->Busy) {
+        x->Worker.join();
+    }
+    if (x->Poll) {
+        clock_free(x->Poll);
+    }
+    euclidean_cancelbuild(x);
+    if (x->BuildPoll) {
+        clock_free(x->BuildPoll);
+    }
+    delete x->Index;
+    euclidean_cancelmatrix(x);
+    if (x->MatrixPoll) {
+        clock_free(x->MatrixPoll);
     }
-    x->out = outlet_new(&x->obj, &s_anything);
-    return (x);
+    x->Cholesky.~vector();
+    x->Whitened.~vector();
+    x->Norms.~vector();
+    x->Matrix.~vector();
+    x->Tiles.~vector();
+    x->Corpus.~vector();
+    x->Query.~vector();
+    x->Nearest.~vector();
+    x->PendingQuery.~vector();
+    x->Atoms.~vector();
+    x->Worker.~thread();
+    x->Done.~atomic();
+    x->Builder.~thread();
+    x->Built.~atomic();
+    x->Cancel.~atomic();
+    x->NextTile.~atomic();
+    x->MatrixWorker.~thread();
+    x->MatrixDone.~atomic();
+    x->MatrixCancel.~atomic();
+    xlab_divergence<euclidean_distance>::destroy(x);
 }
 
 // ─────────────────────────────────────
 void euclidean_setup(void) {
-    Euclidean = class_new(gensym("euclidean"), (t_newmethod)euclidean_new, 0, sizeof(EntropyObj),
-                          0, A_GIMME, 0);
-    class_addcreator((t_newmethod)euclidean_new, gensym("euclidean~"), A_GIMME, 0);
-    CLASS_MAINSIGNALIN(Euclidean, EntropyObj, Sample);
-
-    class_addmethod(Euclidean, (t_method)euclidean_dsp, gensym("dsp"), A_CANT, 0);
-    class_addmethod(Euclidean, (t_method)euclidean_norm, gensym("norm"), A_FLOAT, 0);
-    class_addmethod(Euclidean, (t_method)euclidean_storelist, gensym("_storelist"), A_GIMME, 0);
-    class_addlist(Euclidean, euclidean_list);
-    class_addbang(Euclidean, euclidean_bang);
+    xlab_divergence<euclidean_distance>::setup(sizeof(euclidean), (t_method)euclidean_free,
+                                               euclidean_construct);
+    class_addmethod(Euclidean, (t_method)euclidean_insert, gensym("insert"), A_GIMME, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_load, gensym("load"), A_SYMBOL, A_FLOAT, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_nearest, gensym("nearest"), A_GIMME, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_clear, gensym("clear"), A_NULL);
+    class_addmethod(Euclidean, (t_method)euclidean_index, gensym("index"), A_DEFFLOAT, A_DEFFLOAT,
+                    0);
+    class_addmethod(Euclidean, (t_method)euclidean_ef, gensym("ef"), A_FLOAT, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_write, gensym("write"), A_SYMBOL, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_read, gensym("read"), A_SYMBOL, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_matrix, gensym("matrix"), A_GIMME, 0);
+    class_addmethod(Euclidean, (t_method)euclidean_mahalanobis, gensym("mahalanobis"), A_SYMBOL,
+                    0);
 }
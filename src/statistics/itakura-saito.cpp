@@ -0,0 +1,58 @@
+#include <m_pd.h>
+#include <math.h>
+
+#include "xlab-divergence.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Itakura-Saito divergence between   │
+// │  two power spectra,                 │
+// │  sum P/Q - log(P/Q) - 1. It is      │
+// │  scale invariant, so quiet bins     │
+// │  weigh as much as loud ones.        │
+// ╰─────────────────────────────────────╯
+
+// ─────────────────────────────────────
+// acc[0] = sum P/Q, acc[1] = sum log(P/Q), acc[2] = bins used. With k = S2/S1
+// the normalized divergence is k*acc[0] - acc[1] - acc[2]*(log(k) + 1).
+struct itakura_saito_divergence {
+    static constexpr const char *name = "itakura-saito";
+    static constexpr int terms = 3;
+    static constexpr bool prescale = false;
+    static constexpr bool distribution = true;
+    static constexpr bool alpha = false;
+    static constexpr bool listrms = false;
+    static constexpr bool legacyargs = false;
+
+    // ─────────────────────────────────────
+    static void exact(const xlab_divergence_params &par, double p, double q, double *acc) {
+        if (p > 0 && q > 0) {
+            double r = p / q;
+            acc[0] += r;
+            acc[1] += log(r);
+            acc[2] += 1;
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void fast(const xlab_divergence_params &par, xlab_vfloat p, xlab_vfloat q,
+                     xlab_vfloat *acc) {
+        xlab_vfloat r = xlab_vdiv(p, q);
+        xlab_vfloat l = xlab_vmul(xlab_vsub(xlab_vlog2(p), xlab_vlog2(q)), xlab_vdup(XLAB_LN2));
+        acc[0] = xlab_vadd(acc[0], xlab_vkeep_positive(r, p, q));
+        acc[1] = xlab_vadd(acc[1], xlab_vkeep_positive(l, p, q));
+        acc[2] = xlab_vadd(acc[2], xlab_vkeep_positive(xlab_vdup(1), p, q));
+    }
+
+    // ─────────────────────────────────────
+    static double result(const xlab_divergence_params &par, const double *acc, double s1,
+                         double s2, int n) {
+        if (par.Normalize) {
+            double k = s2 / s1;
+            return k * acc[0] - acc[1] - acc[2] * (log(k) + 1);
+        }
+        return acc[0] - acc[1] - acc[2];
+    }
+};
+
+// ─────────────────────────────────────
+void itakurasaito_setup(void) { xlab_divergence<itakura_saito_divergence>::setup(); }
@@ -0,0 +1,56 @@
+#include <m_pd.h>
+#include <math.h>
+
+#include "xlab-divergence.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Jensen-Shannon divergence, the     │
+// │  symmetric and bounded version of   │
+// │  KL: half of KL(P || M) plus half   │
+// │  of KL(Q || M), M = (P + Q) / 2.    │
+// │  For normalized inputs the result   │
+// │  is between 0 and log(2).           │
+// ╰─────────────────────────────────────╯
+
+// ─────────────────────────────────────
+// M depends on both inputs, so `norm 1` scales them in the loop
+struct js_divergence {
+    static constexpr const char *name = "js";
+    static constexpr int terms = 1;
+    static constexpr bool prescale = true;
+    static constexpr bool distribution = true;
+    static constexpr bool alpha = false;
+    static constexpr bool listrms = false;
+    static constexpr bool legacyargs = false;
+
+    // ─────────────────────────────────────
+    static void exact(const xlab_divergence_params &par, double p, double q, double *acc) {
+        double m = (p + q) * 0.5;
+        if (p > 0 && m > 0) {
+            acc[0] += p * log(p / m);
+        }
+        if (q > 0 && m > 0) {
+            acc[0] += q * log(q / m);
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void fast(const xlab_divergence_params &par, xlab_vfloat p, xlab_vfloat q,
+                     xlab_vfloat *acc) {
+        xlab_vfloat m = xlab_vmul(xlab_vadd(p, q), xlab_vdup(0.5f));
+        xlab_vfloat lm = xlab_vlog2(m);
+        xlab_vfloat tp = xlab_vmul(p, xlab_vsub(xlab_vlog2(p), lm));
+        xlab_vfloat tq = xlab_vmul(q, xlab_vsub(xlab_vlog2(q), lm));
+        xlab_vfloat term = xlab_vadd(xlab_vkeep_positive(tp, p, m), xlab_vkeep_positive(tq, q, m));
+        acc[0] = xlab_vadd(acc[0], xlab_vmul(term, xlab_vdup(XLAB_LN2)));
+    }
+
+    // ─────────────────────────────────────
+    static double result(const xlab_divergence_params &par, const double *acc, double s1,
+                         double s2, int n) {
+        return acc[0] * 0.5;
+    }
+};
+
+// ─────────────────────────────────────
+void jensenshannon_setup(void) { xlab_divergence<js_divergence>::setup(); }
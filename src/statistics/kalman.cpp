@@ -5,70 +5,220 @@
 */
 
 #define MAX_ITERATIONS 100
-#define MAX_LIST_SIZE 128
 #define DEFAULT_ITERATIONS 30
 #define DEFAULT_INIT_VALUE 0.0000000000001
 #define DEFAULT_NOISE_COVARIANCE 0.5
+#define DEFAULT_PROCESS_NOISE 0.001
 
+#include <algorithm>
 #include <m_pd.h>
 #include <math.h>
 #include <stdlib.h>
+#include <vector>
+
+#include "xlab-simd.hpp"
 
 t_class *kalman_class;
+t_class *kalman_tilde_class;
 
 typedef struct kalman {
     t_object x_obj;
     t_outlet *filter_out;
     t_outlet *accuracy_out;
-    t_float noise_covariance, init_value;
+    t_float noise_covariance, init_value, process_noise;
     t_int iterations, index, count;
     bool toggle_analyze;
-    double sum, sumsquares, sumvariance;
+    bool recursive;
+    double mean, m2, diffsquares;
     double analyze_mean, analyze_sd, analyze_variance;
+    double tune_alpha, tune_diffsquares;
+    bool primed;
     double state_estimate;
     double estimate_covariance;
     t_float previous;
     t_float *history;
-    t_float **list_history;
+
+    // lists run one filter per value. The gains only depend on the noise
+    // settings, so all channels share one covariance and the states are kept
+    // channel-contiguous, padded to whole vectors, and updated in one pass.
+    int channels, stride, list_index, list_iterations;
+    bool list_primed;
+    double list_covariance;
+    std::vector<float> list_state;
+    std::vector<float> list_input;
+    std::vector<float> list_history;
+    std::vector<t_atom> list_atoms;
 } t_kalman;
 
 // ─────────────────────────────────────
-static void analyze(t_kalman *x, t_float f);
+static void analyze(t_kalman *x, t_float f, double diff);
+
+// ─────────────────────────────────────
+// exponential average of the squared successive differences; those of white
+// noise have twice its variance, the smooth part of the signal barely
+// contributes from one value to the next
+static inline void kalman_tune(t_kalman *x, double diffsquare) {
+    x->tune_diffsquares += x->tune_alpha * (diffsquare - x->tune_diffsquares);
+    x->noise_covariance = fmax(x->tune_diffsquares / 2, 1e-12);
+}
+
+// ─────────────────────────────────────
+static inline void kalman_step(double *xk, double *Pk, double Zk, double R) {
+    double Kk = *Pk / (*Pk + R);
+    *xk = *xk + Kk * (Zk - *xk);
+    *Pk = (1 - Kk) * *Pk;
+}
+
+// ─────────────────────────────────────
+static void kalman_reset(t_kalman *x) {
+    x->state_estimate = x->init_value;
+    x->estimate_covariance = 1;
+    // the next list starts the channels again
+    x->channels = 0;
+}
 
 // ─────────────────────────────────────
 static void kalman_float(t_kalman *x, t_floatarg f) {
+    double diff = f - x->previous;
     if (x->toggle_analyze) {
-        analyze(x, f);
-    }
-    x->history[x->index] = f;
-    x->index = (x->index + 1) % x->iterations;
-    double Pk = 1;
-    double xk = (double)x->init_value;
-    int i;
-    for (i = 0; i < x->iterations; i++) {
-        double Zk = (double)x->history[(i + x->index) % x->iterations];
-        double Kk = Pk / (Pk + (double)x->noise_covariance);
-        xk = xk + Kk * (Zk - xk);
-        Pk = (1 - Kk) * Pk;
+        analyze(x, f, diff);
+    }
+    if (x->tune_alpha > 0 && x->primed) {
+        kalman_tune(x, diff * diff);
+    }
+    x->previous = f;
+    x->primed = true;
+    double R = (double)x->noise_covariance;
+    double xk, Pk;
+    if (x->recursive) {
+        // predict with the process noise, then correct, the state is carried over
+        Pk = x->estimate_covariance + (double)x->process_noise;
+        xk = x->state_estimate;
+        kalman_step(&xk, &Pk, f, R);
+        x->state_estimate = xk;
+        x->estimate_covariance = Pk;
+    } else {
+        // refit over the window, oldest value first, in two runs instead of a modulo per step
+        x->history[x->index] = f;
+        x->index = (x->index + 1) % x->iterations;
+        Pk = 1;
+        xk = (double)x->init_value;
+        for (int i = x->index; i < x->iterations; i++) {
+            kalman_step(&xk, &Pk, x->history[i], R);
+        }
+        for (int i = 0; i < x->index; i++) {
+            kalman_step(&xk, &Pk, x->history[i], R);
+        }
     }
     outlet_float(x->filter_out, xk);
     outlet_float(x->accuracy_out, xk);
 }
 
 // ─────────────────────────────────────
-static void analyze(t_kalman *x, t_float f) {
+static void kalman_channels(t_kalman *x, int n) {
+    x->channels = n;
+    x->stride = (n + 3) / 4 * 4;
+    x->list_state.assign(x->stride, x->init_value);
+    x->list_input.assign(x->stride, 0);
+    x->list_covariance = 1;
+    x->list_history.clear();
+    x->list_iterations = 0;
+    x->list_index = 0;
+    x->list_primed = false;
+    x->list_atoms.resize(n);
+}
+
+// ─────────────────────────────────────
+// x += K * (z - x) for all channels
+static inline void kalman_liststep(float *state, const float *z, int stride, double K) {
+    xlab_vfloat k = xlab_vdup(K);
+    for (int c = 0; c < stride; c += 4) {
+        xlab_vfloat xk = xlab_vload(state + c);
+        xlab_vstore(state + c, xlab_vadd(xk, xlab_vmul(k, xlab_vsub(xlab_vload(z + c), xk))));
+    }
+}
+
+// ─────────────────────────────────────
+// window refit over history rows first..last - 1
+static void kalman_listrun(t_kalman *x, int first, int last, double *Pk) {
+    double R = (double)x->noise_covariance;
+    for (int row = first; row < last; row++) {
+        double Kk = *Pk / (*Pk + R);
+        kalman_liststep(x->list_state.data(), &x->list_history[row * x->stride], x->stride, Kk);
+        *Pk = (1 - Kk) * *Pk;
+    }
+}
+
+// ─────────────────────────────────────
+static void kalman_list(t_kalman *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc == 0) {
+        return;
+    } else if (argc != x->channels) {
+        kalman_channels(x, argc);
+    }
+    // every channel value goes to analyze with the difference to the previous
+    // list, autotune takes one step per list with the mean over the channels
+    double diffsquares = 0;
+    for (int i = 0; i < argc; i++) {
+        t_float f = atom_getfloat(argv + i);
+        double diff = f - x->list_input[i];
+        if (x->toggle_analyze && x->list_primed) {
+            analyze(x, f, diff);
+        }
+        diffsquares += diff * diff;
+        x->list_input[i] = f;
+    }
+    if (x->tune_alpha > 0 && x->list_primed) {
+        kalman_tune(x, diffsquares / argc);
+    }
+    x->list_primed = true;
+    double R = (double)x->noise_covariance;
+    float *state = x->list_state.data();
+    if (x->recursive) {
+        double Pk = x->list_covariance + (double)x->process_noise;
+        double Kk = Pk / (Pk + R);
+        kalman_liststep(state, x->list_input.data(), x->stride, Kk);
+        x->list_covariance = (1 - Kk) * Pk;
+    } else {
+        // one row of channels per step, allocated when the window is first used
+        int iterations = x->iterations;
+        if (x->list_iterations != iterations) {
+            x->list_history.assign((size_t)iterations * x->stride, x->init_value);
+            x->list_iterations = iterations;
+            x->list_index = 0;
+        }
+        float *history = x->list_history.data();
+        std::copy(x->list_input.begin(), x->list_input.end(), history + x->list_index * x->stride);
+        x->list_index = (x->list_index + 1) % iterations;
+        std::fill(x->list_state.begin(), x->list_state.end(), x->init_value);
+        double Pk = 1;
+        kalman_listrun(x, x->list_index, iterations, &Pk);
+        kalman_listrun(x, 0, x->list_index, &Pk);
+    }
+    for (int i = 0; i < argc; i++) {
+        SETFLOAT(&x->list_atoms[i], state[i]);
+    }
+    outlet_list(x->filter_out, &s_list, argc, x->list_atoms.data());
+    outlet_list(x->accuracy_out, &s_list, argc, x->list_atoms.data());
+}
+
+// ─────────────────────────────────────
+// Welford running mean and variance, and the running mean of the squared
+// successive differences, half of which estimates the measurement noise.
+// Only means are updated, so nothing grows or cancels on long runs.
+static void analyze(t_kalman *x, t_float f, double diff) {
     x->count++;
-    x->sum += f;
-    x->sumsquares += (f * f);
-    x->sumvariance += fabs(f - x->previous);
-    x->previous = f;
-    x->analyze_mean = x->sum / x->count;
-    x->analyze_variance = x->sumvariance / x->count;
+    double delta = f - x->mean;
+    x->mean += delta / x->count;
+    x->m2 += delta * (f - x->mean);
+    x->analyze_mean = x->mean;
     if (x->count == 1) {
         x->analyze_sd = 1;
-    } else {
-        x->analyze_sd = sqrt(x->sumsquares - (x->sum * x->sum) / (x->count - 1));
+        return;
     }
+    x->analyze_sd = sqrt(x->m2 / (x->count - 1));
+    x->diffsquares += (diff * diff - x->diffsquares) / (x->count - 1);
+    x->analyze_variance = x->diffsquares / 2;
 }
 
 // ─────────────────────────────────────
@@ -85,6 +235,33 @@ static void kalman_setnoise(t_kalman *x, t_float f) {
 static void kalman_setinit(t_kalman *x, t_float f) {
     post("[kalman] initial val set to %f", f);
     x->init_value = f;
+    kalman_reset(x);
+}
+
+// ─────────────────────────────────────
+static void kalman_setprocess(t_kalman *x, t_float f) {
+    if ((float)f < 0) {
+        pd_error(x, "[kalman] process noise cannot be less than 0");
+    } else {
+        post("[kalman] process noise set to %f", f);
+        x->process_noise = f;
+    }
+}
+
+// ─────────────────────────────────────
+// recursive: O(1) per value, state and covariance carried between values
+// window: the filter is refit over the last `iterations` values every time
+static void kalman_setmode(t_kalman *x, t_symbol *s) {
+    if (s == gensym("recursive")) {
+        x->recursive = true;
+        kalman_reset(x);
+    } else if (s == gensym("window")) {
+        x->recursive = false;
+    } else {
+        pd_error(x, "[kalman] mode must be recursive or window");
+        return;
+    }
+    post("[kalman] mode set to %s", s->s_name);
 }
 
 // ─────────────────────────────────────
@@ -99,7 +276,7 @@ static void kalman_setiterations(t_kalman *x, t_float f) {
         pd_error(x, "[kalman] exceeded maximum of %d iterations", MAX_ITERATIONS);
     }
     post("[kalman] number of iterations set to %d", iter);
-    x->iterations = f;
+    x->iterations = iter;
 }
 
 // ─────────────────────────────────────
@@ -107,17 +284,23 @@ static void kalman_setanalyze(t_kalman *x, t_float f) {
     if (f > 0) {
         x->toggle_analyze = true;
         x->count = 0;
-        x->sum = 0;
-        x->sumsquares = 0;
+        x->mean = 0;
+        x->m2 = 0;
+        x->diffsquares = 0;
         post("[kalman] analyzing input for optimal coefficients");
-    } else {
+    } else if (x->toggle_analyze) {
         x->toggle_analyze = false;
+        if (x->count < 2 || x->analyze_variance <= 0) {
+            pd_error(x, "[kalman] not enough varying input to analyze");
+            return;
+        }
         x->init_value = (t_float)x->analyze_mean;
         x->noise_covariance = (t_float)x->analyze_variance;
         int i;
         for (i = 0; i < MAX_ITERATIONS; i++) {
             x->history[i] = x->init_value;
         }
+        kalman_reset(x);
         post("[kalman] analyze mode off");
         post("[kalman] mean: %f, standard deviation: %f, noise "
              "covariance: %f",
@@ -125,6 +308,22 @@ static void kalman_setanalyze(t_kalman *x, t_float f) {
     }
 }
 
+// ─────────────────────────────────────
+// autotune <n> keeps re-estimating the noise covariance from the input, an
+// exponential average with a half-life of n values (n lists for lists, see
+// kalman_list), 0 turns it off. Unlike analyze it never stops and leaves the
+// history and the state alone.
+static void kalman_setautotune(t_kalman *x, t_float f) {
+    if (f <= 0) {
+        x->tune_alpha = 0;
+        post("[kalman] autotune off");
+        return;
+    }
+    x->tune_alpha = 1 - pow(2, -1 / (double)f);
+    x->tune_diffsquares = 2 * (double)x->noise_covariance;
+    post("[kalman] autotune with a half-life of %g values", f);
+}
+
 // ─────────────────────────────────────
 static void *kalman_new(t_symbol *s, int argc, t_atom *argv) {
     t_kalman *x = (t_kalman *)pd_new(kalman_class);
@@ -134,8 +333,10 @@ static void *kalman_new(t_symbol *s, int argc, t_atom *argv) {
     x->iterations = DEFAULT_ITERATIONS;
     x->noise_covariance = DEFAULT_NOISE_COVARIANCE;
     x->init_value = DEFAULT_INIT_VALUE;
+    x->process_noise = DEFAULT_PROCESS_NOISE;
     x->index = 0;
     x->toggle_analyze = false;
+    x->recursive = false;
 
     switch (argc) {
     case 3:
@@ -146,29 +347,211 @@ static void *kalman_new(t_symbol *s, int argc, t_atom *argv) {
         x->iterations = atom_getfloat(argv);
     }
 
+    kalman_reset(x);
+
     x->history = new t_float[MAX_ITERATIONS];
     for (int i = 0; i < MAX_ITERATIONS; i++) {
         x->history[i] = x->init_value;
     }
 
-    x->list_history = new t_float *[MAX_LIST_SIZE];
-    for (int i = 0; i < MAX_LIST_SIZE; i++) {
-        x->list_history[i] = new t_float[MAX_ITERATIONS];
-        for (int j = 0; j < MAX_ITERATIONS; j++) {
-            x->list_history[i][j] = x->init_value;
-        }
-    }
-
     return (void *)x;
 }
 
 // ─────────────────────────────────────
 static void kalman_free(t_kalman *x) {
     delete[] x->history;
-    for (int i = 0; i < MAX_LIST_SIZE; i++) {
-        delete[] x->list_history[i];
+    x->list_state.~vector();
+    x->list_input.~vector();
+    x->list_history.~vector();
+    x->list_atoms.~vector();
+}
+
+// ─────────────────────────────────────
+// kalman~: the recursive filter at signal rate, one state and covariance per
+// channel of a multichannel input. The right inlet is the measurement noise,
+// one channel for all or one per channel. Groups of 4 channels are filtered
+// together, sample by sample, with the states in the lanes of one vector.
+typedef struct kalman_tilde {
+    t_object x_obj;
+    t_sample x_f;
+    t_float init_value, process_noise;
+    bool block;
+    bool reset;
+    int channels;
+    std::vector<float> state;
+    std::vector<float> covariance;
+    std::vector<t_sample> noise;
+} t_kalman_tilde;
+
+// ─────────────────────────────────────
+static void kalman_tilde_group(t_kalman_tilde *x, int c, const t_sample *in, const t_sample *R,
+                               int rchans, t_sample *out, int n) {
+    const t_sample *z0 = in + c * n, *z1 = z0 + n, *z2 = z1 + n, *z3 = z2 + n;
+    const t_sample *r0 = rchans == 1 ? R : R + c * n;
+    const t_sample *r1 = rchans == 1 ? R : r0 + n;
+    const t_sample *r2 = rchans == 1 ? R : r1 + n;
+    const t_sample *r3 = rchans == 1 ? R : r2 + n;
+    t_sample *o0 = out + c * n, *o1 = o0 + n, *o2 = o1 + n, *o3 = o2 + n;
+    xlab_vfloat xk = xlab_vload(&x->state[c]);
+    xlab_vfloat Pk = xlab_vload(&x->covariance[c]);
+    xlab_vfloat Q = xlab_vdup(x->process_noise);
+    xlab_vfloat one = xlab_vdup(1);
+    xlab_vfloat tiny = xlab_vdup(1e-12f);
+    float lanes[4];
+    for (int i = 0; i < n; i++) {
+        xlab_vfloat Zk = xlab_vset(z0[i], z1[i], z2[i], z3[i]);
+        xlab_vfloat Rk = xlab_vmax(xlab_vset(r0[i], r1[i], r2[i], r3[i]), tiny);
+        Pk = xlab_vadd(Pk, Q);
+        xlab_vfloat Kk = xlab_vdiv(Pk, xlab_vadd(Pk, Rk));
+        xk = xlab_vadd(xk, xlab_vmul(Kk, xlab_vsub(Zk, xk)));
+        Pk = xlab_vmul(xlab_vsub(one, Kk), Pk);
+        xlab_vstore(lanes, xk);
+        o0[i] = lanes[0];
+        o1[i] = lanes[1];
+        o2[i] = lanes[2];
+        o3[i] = lanes[3];
+    }
+    xlab_vstore(&x->state[c], xk);
+    xlab_vstore(&x->covariance[c], Pk);
+}
+
+// ─────────────────────────────────────
+static void kalman_tilde_channel(t_kalman_tilde *x, int c, const t_sample *in, const t_sample *R,
+                                 int rchans, t_sample *out, int n) {
+    const t_sample *z = in + c * n;
+    const t_sample *r = rchans == 1 ? R : R + c * n;
+    t_sample *o = out + c * n;
+    float xk = x->state[c];
+    float Pk = x->covariance[c];
+    for (int i = 0; i < n; i++) {
+        Pk += x->process_noise;
+        float Kk = Pk / (Pk + fmaxf(r[i], 1e-12f));
+        xk += Kk * (z[i] - xk);
+        Pk *= 1 - Kk;
+        o[i] = xk;
+    }
+    x->state[c] = xk;
+    x->covariance[c] = Pk;
+}
+
+// ─────────────────────────────────────
+// block mode: one update per block with the block means, the output holds the estimate
+static void kalman_tilde_block(t_kalman_tilde *x, int c, const t_sample *in, const t_sample *R,
+                               int rchans, t_sample *out, int n) {
+    const t_sample *z = in + c * n;
+    const t_sample *r = rchans == 1 ? R : R + c * n;
+    double zsum = 0, rsum = 0;
+    for (int i = 0; i < n; i++) {
+        zsum += z[i];
+        rsum += r[i];
+    }
+    float Pk = x->covariance[c] + x->process_noise;
+    float Kk = Pk / (Pk + fmaxf(rsum / n, 1e-12f));
+    x->state[c] += Kk * (zsum / n - x->state[c]);
+    x->covariance[c] = (1 - Kk) * Pk;
+    std::fill(out + c * n, out + (c + 1) * n, x->state[c]);
+}
+
+// ─────────────────────────────────────
+static t_int *kalman_tilde_perform(t_int *w) {
+    t_kalman_tilde *x = (t_kalman_tilde *)(w[1]);
+    t_sample *in = (t_sample *)(w[2]);
+    t_sample *R = (t_sample *)(w[3]);
+    t_sample *out = (t_sample *)(w[4]);
+    int n = (int)(w[5]);
+    int nchans = (int)(w[6]);
+    int rchans = (int)(w[7]);
+
+    if (x->reset) {
+        std::fill(x->state.begin(), x->state.end(), x->init_value);
+        std::fill(x->covariance.begin(), x->covariance.end(), 1.0f);
+        x->reset = false;
+    }
+    // the output may share its buffer with the noise input
+    std::copy(R, R + rchans * n, x->noise.begin());
+    R = x->noise.data();
+
+    int c = 0;
+    if (x->block) {
+        for (; c < nchans; c++) {
+            kalman_tilde_block(x, c, in, R, rchans, out, n);
+        }
+    }
+    for (; c + 4 <= nchans; c += 4) {
+        kalman_tilde_group(x, c, in, R, rchans, out, n);
     }
-    delete[] x->list_history;
+    for (; c < nchans; c++) {
+        kalman_tilde_channel(x, c, in, R, rchans, out, n);
+    }
+    return (w + 8);
+}
+
+// ─────────────────────────────────────
+static void kalman_tilde_dsp(t_kalman_tilde *x, t_signal **sp) {
+#ifdef CLASS_MULTICHANNEL
+    int nchans = sp[0]->s_nchans;
+    int rchans = sp[1]->s_nchans;
+    signal_setmultiout(&sp[2], nchans);
+#else
+    int nchans = 1;
+    int rchans = 1;
+#endif
+    if (rchans != 1 && rchans != nchans) {
+        pd_error(x, "[kalman~] noise needs 1 or %d channels, got %d", nchans, rchans);
+        rchans = 1;
+    }
+    if (nchans != x->channels) {
+        x->channels = nchans;
+        x->state.assign((nchans + 3) / 4 * 4, x->init_value);
+        x->covariance.assign((nchans + 3) / 4 * 4, 1.0f);
+    }
+    x->noise.resize((size_t)rchans * sp[0]->s_n);
+    dsp_add(kalman_tilde_perform, 7, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_n,
+            nchans, rchans);
+}
+
+// ─────────────────────────────────────
+static void kalman_tilde_setprocess(t_kalman_tilde *x, t_float f) {
+    x->process_noise = f < 0 ? 0 : f;
+}
+
+// ─────────────────────────────────────
+static void kalman_tilde_setinit(t_kalman_tilde *x, t_float f) {
+    x->init_value = f;
+    x->reset = true;
+}
+
+// ─────────────────────────────────────
+static void kalman_tilde_reset(t_kalman_tilde *x) { x->reset = true; }
+
+// ─────────────────────────────────────
+static void kalman_tilde_setmode(t_kalman_tilde *x, t_symbol *s) {
+    if (s == gensym("block")) {
+        x->block = true;
+    } else if (s == gensym("sample")) {
+        x->block = false;
+    } else {
+        pd_error(x, "[kalman~] mode must be sample or block");
+    }
+}
+
+// ─────────────────────────────────────
+// [kalman~ <noise covariance> <process noise>]
+static void *kalman_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    t_kalman_tilde *x = (t_kalman_tilde *)pd_new(kalman_tilde_class);
+    t_float noise = argc > 0 ? atom_getfloat(argv) : DEFAULT_NOISE_COVARIANCE;
+    x->process_noise = argc > 1 ? atom_getfloat(argv + 1) : DEFAULT_PROCESS_NOISE;
+    x->init_value = 0;
+    signalinlet_new(&x->x_obj, noise);
+    outlet_new(&x->x_obj, &s_signal);
+    return (void *)x;
+}
+
+// ─────────────────────────────────────
+static void kalman_tilde_free(t_kalman_tilde *x) {
+    x->state.~vector();
+    x->covariance.~vector();
+    x->noise.~vector();
 }
 
 // ─────────────────────────────────────
@@ -180,6 +563,28 @@ void kalman_setup(void) {
     class_addmethod(kalman_class, (t_method)kalman_setinit, gensym("init"), A_FLOAT, 0);
     class_addmethod(kalman_class, (t_method)kalman_setinit, gensym("mean"), A_FLOAT, 0);
     class_addmethod(kalman_class, (t_method)kalman_setanalyze, gensym("analyze"), A_FLOAT, 0);
+    class_addmethod(kalman_class, (t_method)kalman_setprocess, gensym("process"), A_FLOAT, 0);
+    class_addmethod(kalman_class, (t_method)kalman_setautotune, gensym("autotune"), A_FLOAT, 0);
+    class_addmethod(kalman_class, (t_method)kalman_setmode, gensym("mode"), A_SYMBOL, 0);
+    class_addmethod(kalman_class, (t_method)kalman_reset, gensym("reset"), A_NULL);
     class_addfloat(kalman_class, kalman_float);
-    // class_addlist(kalman_class, kalman_list);
+    class_addlist(kalman_class, (t_method)kalman_list);
+
+#ifdef CLASS_MULTICHANNEL
+    int flags = CLASS_MULTICHANNEL;
+#else
+    int flags = CLASS_DEFAULT;
+#endif
+    kalman_tilde_class =
+        class_new(gensym("kalman~"), (t_newmethod)kalman_tilde_new, (t_method)kalman_tilde_free,
+                  sizeof(t_kalman_tilde), flags, A_GIMME, 0);
+    CLASS_MAINSIGNALIN(kalman_tilde_class, t_kalman_tilde, x_f);
+    class_addmethod(kalman_tilde_class, (t_method)kalman_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(kalman_tilde_class, (t_method)kalman_tilde_setprocess, gensym("process"),
+                    A_FLOAT, 0);
+    class_addmethod(kalman_tilde_class, (t_method)kalman_tilde_setinit, gensym("init"), A_FLOAT,
+                    0);
+    class_addmethod(kalman_tilde_class, (t_method)kalman_tilde_setmode, gensym("mode"), A_SYMBOL,
+                    0);
+    class_addmethod(kalman_tilde_class, (t_method)kalman_tilde_reset, gensym("reset"), A_NULL);
 }
@@ -1,188 +1,73 @@
 #include <m_pd.h>
 #include <math.h>
 
-static t_class *renyi_class;
+#include "xlab-divergence.hpp"
 
-// ─────────────────────────────────────
-class renyi {
-  public:
-
-    t_object Obj;
-    t_sample Sample;
-
-    float Alpha;
-
-    bool RealTime;
-    bool Normalize;
-    bool Exp;
-
-    t_clock *Clock;
-
-    t_inlet *In2;
-    t_outlet *Out;
-
-    t_symbol *Q;
-    t_symbol *P;
-
-    t_float Diversity;
-};
+// ╭─────────────────────────────────────╮
+// │  Rényi divergence of order alpha,   │
+// │  log(sum P^a * Q^(1-a)) / (a - 1).  │
+// │  At alpha 1 it is the limit, the    │
+// │  Kullback-Leibler divergence.       │
+// ╰─────────────────────────────────────╯
 
 // ─────────────────────────────────────
-static void renyi_bang(renyi *x) {
-    t_float RenyiDiv = 0.0;
-    t_garray *Arr1 = (t_garray *)pd_findbyclass(x->P, garray_class);
-    t_garray *Arr2 = (t_garray *)pd_findbyclass(x->Q, garray_class);
-    if (!Arr1 || !Arr2) {
-        pd_error(x, "[renyi] couldn't find some table");
-        return;
-    }
-    t_word *Arr1Vec;
-    int Arr1Size;
-    garray_getfloatwords(Arr1, &Arr1Size, &Arr1Vec);
-
-    t_word *Arr2Vec;
-    int Arr2Size;
-    garray_getfloatwords(Arr2, &Arr2Size, &Arr2Vec);
-    if (Arr1Size != Arr2Size) {
-        pd_error(x, "[renyi] tables must have the same size");
-        return;
-    }
-    if (x->Normalize) {
-        float Sum1 = 0.0;
-        float Sum2 = 0.0;
-        for (int i = 0; i < Arr1Size; i++) {
-            Sum1 += Arr1Vec[i].w_float;
-            Sum2 += Arr2Vec[i].w_float;
-        }
-        for (int i = 0; i < Arr1Size; i++) {
-            Arr1Vec[i].w_float /= Sum1;
-            Arr2Vec[i].w_float /= Sum2;
-        }
-    }
-
-    for (int i = 0; i < Arr1Size; i++) {
-        float IVec1 = Arr1Vec[i].w_float;
-        float IVec2 = Arr2Vec[i].w_float;
-        if (IVec1 > 0 && IVec2 > 0) {
-            RenyiDiv += pow(IVec1, x->Alpha) * pow(IVec2, 1 - x->Alpha);
+// The normalization is applied analytically:
+// sum (P/S1)^a * (Q/S2)^(1-a) = S1^-a * S2^(a-1) * C, with C = sum P^a * Q^(1-a)
+// over the bins where P and Q are positive.
+struct renyi_divergence {
+    static constexpr const char *name = "renyi";
+    static constexpr int terms = 3;
+    static constexpr bool prescale = false;
+    static constexpr bool distribution = true;
+    static constexpr bool alpha = true;
+    static constexpr bool listrms = false;
+    static constexpr bool legacyargs = true;
+
+    // ─────────────────────────────────────
+    static void exact(const xlab_divergence_params &par, double p, double q, double *acc) {
+        if (p > 0 && q > 0) {
+            if (par.Alpha == 1) {
+                acc[1] += p * log(p / q);
+                acc[2] += p;
+            } else {
+                acc[0] += pow(p, par.Alpha) * pow(q, 1 - par.Alpha);
+            }
         }
     }
 
-    RenyiDiv = log(RenyiDiv) / (x->Alpha - 1.0);
-
-    // Set the diversity value and output it
-    x->Diversity = RenyiDiv;
-
-    outlet_float(x->Out, x->Diversity);
-}
-
-// ─────────────────────────────────────
-static void renyi_alpha(renyi *x, t_floatarg f) { x->Alpha = f; }
-// ─────────────────────────────────────
-static void renyi_expo(renyi *x, t_floatarg f) { x->Exp = f; }
-// ─────────────────────────────────────
-static void renyi_tick(renyi *x) { outlet_float(x->Out, x->Diversity); }
-// ─────────────────────────────────────
-static void renyi_norm(renyi *x, t_floatarg f) {
-    if (f == 1) {
-        x->Normalize = true;
-    } else {
-        x->Normalize = false;
-    }
-    return;
-}
-
-// ─────────────────────────────────────
-static t_int *renyi_perform(t_int *w) {
-    renyi *x = (renyi *)(w[1]);
-    t_float *Arr1Vec = (t_float *)(w[2]);
-    t_float *Arr2Vec = (t_float *)(w[3]);
-    int n = (int)(w[4]);
-
-    // check if input 1 or 2 is silence
-    float Vec1Sum = 0.0;
-    float Vec2Sum = 0.0;
-    for (int i = 0; i < n; i++) {
-        Vec1Sum += Arr1Vec[i];
-        Vec2Sum += Arr2Vec[i];
-    }
-    if (Vec1Sum == 0 || Vec2Sum == 0) {
-        x->Diversity = 0.0;
-        clock_delay(x->Clock, 0);
-        return (w + 5);
-    }
-
-    t_float RenyiDiv = 0.0;
-    if (x->Normalize) {
-        float Sum1 = 0.0;
-        float Sum2 = 0.0;
-        for (int i = 0; i < n; i++) {
-            Sum1 += Arr1Vec[i];
-            Sum2 += Arr2Vec[i];
-        }
-        for (int i = 0; i < n; i++) {
-            Arr1Vec[i] /= Sum1;
-            Arr2Vec[i] /= Sum2;
+    // ─────────────────────────────────────
+    // P^a * Q^(1-a) = exp2(a*log2(P) + (1-a)*log2(Q))
+    static void fast(const xlab_divergence_params &par, xlab_vfloat p, xlab_vfloat q,
+                     xlab_vfloat *acc) {
+        xlab_vfloat lp = xlab_vlog2(p);
+        xlab_vfloat lq = xlab_vlog2(q);
+        if (par.Alpha == 1) {
+            xlab_vfloat term = xlab_vmul(xlab_vmul(p, xlab_vsub(lp, lq)), xlab_vdup(XLAB_LN2));
+            acc[1] = xlab_vadd(acc[1], xlab_vkeep_positive(term, p, q));
+            acc[2] = xlab_vadd(acc[2], xlab_vkeep_positive(p, p, q));
+        } else {
+            xlab_vfloat e = xlab_vadd(xlab_vmul(xlab_vdup(par.Alpha), lp),
+                                      xlab_vmul(xlab_vdup(1 - par.Alpha), lq));
+            acc[0] = xlab_vadd(acc[0], xlab_vkeep_positive(xlab_vexp2(e), p, q));
         }
     }
 
-    for (int i = 0; i < n; i++) {
-        float IVec1 = Arr1Vec[i];
-        float IVec2 = Arr2Vec[i];
-        if (IVec1 > 0 && IVec2 > 0) {
-            RenyiDiv += pow(IVec1, x->Alpha) * pow(IVec2, 1 - x->Alpha);
+    // ─────────────────────────────────────
+    static double result(const xlab_divergence_params &par, const double *acc, double s1,
+                         double s2, int n) {
+        if (par.Alpha == 1) {
+            if (par.Normalize) {
+                return acc[1] / s1 + acc[2] / s1 * log(s2 / s1);
+            }
+            return acc[1];
         }
-    }
-
-    RenyiDiv = log(RenyiDiv) / (x->Alpha - 1.0);
-
-    x->Diversity = RenyiDiv;
-    clock_delay(x->Clock, 0);
-
-    return (w + 5);
-}
-
-// ─────────────────────────────────────
-static void renyi_dsp(renyi *x, t_signal **sp) {
-    if (x->RealTime) {
-        dsp_add(renyi_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
-    }
-}
-
-// ─────────────────────────────────────
-static void *renyi_new(t_symbol *s, int argc, t_atom *argv) {
-    renyi *x = (renyi *)pd_new(renyi_class);
-    bool isSinal = false;
-    if (s == gensym("renyi~")) {
-        isSinal = true;
-    }
-    if (argc == 2) {
-        x->RealTime = false;
-        if (argv[0].a_type != A_SYMBOL || argv[1].a_type != A_SYMBOL) {
-            pd_error(x, "[renyi~] arg1 and arg2 must be symbols");
-            return NULL;
+        double C = acc[0];
+        if (par.Normalize) {
+            C *= pow(s1, -par.Alpha) * pow(s2, par.Alpha - 1);
         }
-        x->P = atom_getsymbol(argv);
-        x->Q = atom_getsymbol(argv + 1);
-    } else {
-        x->RealTime = true;
-        x->In2 = inlet_new(&x->Obj, &x->Obj.ob_pd, &s_signal, &s_signal);
-        x->Clock = clock_new(x, (t_method)renyi_tick);
+        return log(C) / (par.Alpha - 1.0);
     }
-    x->Out = outlet_new(&x->Obj, &s_anything);
-    x->Alpha = 1.0;
-    return (x);
-}
+};
 
 // ─────────────────────────────────────
-void renyi_setup(void) {
-    renyi_class =
-        class_new(gensym("renyi"), (t_newmethod)renyi_new, 0, sizeof(renyi), 0, A_GIMME, 0);
-    class_addcreator((t_newmethod)renyi_new, gensym("renyi~"), A_GIMME, 0);
-    CLASS_MAINSIGNALIN(renyi_class, renyi, Sample);
-    class_addmethod(renyi_class, (t_method)renyi_dsp, gensym("dsp"), A_CANT, 0);
-    class_addmethod(renyi_class, (t_method)renyi_norm, gensym("norm"), A_FLOAT, 0);
-    class_addmethod(renyi_class, (t_method)renyi_alpha, gensym("alpha"), A_FLOAT, 0);
-    class_addmethod(renyi_class, (t_method)renyi_expo, gensym("exp"), A_FLOAT, 0);
-    class_addbang(renyi_class, renyi_bang);
-}
+void renyi_setup(void) { xlab_divergence<renyi_divergence>::setup(); }
@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 
+#include "xlab-array.hpp"
+
 static t_class *infinite_record_class;
 
 class infinite_record {
@@ -83,7 +85,7 @@ static void infinite_record_stop(infinite_record *x) {
     }
 
     x->write_index = n;
-    garray_redraw(array);
+    xlab_redraw::request(gensym(x->arrayname.c_str()));
     x->buffer.clear();
 }
 
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <m_pd.h>
+#include <vector>
+
+// ╭─────────────────────────────────────╮
+// │  Array bound by name. set keeps the │
+// │  symbol, get looks the array up and │
+// │  fetches its words on every call,   │
+// │  so a deleted or resized array is   │
+// │  never read through stale pointers. │
+// │  array, vec and size are valid      │
+// │  until the next message. Locals     │
+// │  start unbound.                     │
+// ╰─────────────────────────────────────╯
+
+class xlab_array {
+  public:
+    t_symbol *name = nullptr;
+    t_garray *array = nullptr;
+    t_word *vec = nullptr;
+    int size = 0;
+
+    // ─────────────────────────────────────
+    void set(t_symbol *s) {
+        name = s;
+        array = nullptr;
+        vec = nullptr;
+        size = 0;
+    }
+
+    // ─────────────────────────────────────
+    // Validate the handle, prefix is the object name used for the error messages.
+    bool get(const void *owner, const char *prefix) {
+        if (!name) {
+            pd_error(owner, "[%s] No array set.", prefix);
+            return false;
+        }
+        t_garray *a = (t_garray *)pd_findbyclass(name, garray_class);
+        if (!a) {
+            pd_error(owner, "[%s] Array %s not found.", prefix, name->s_name);
+            array = nullptr;
+            return false;
+        }
+        if (!garray_getfloatwords(a, &size, &vec)) {
+            pd_error(owner, "[%s] Bad template for tabwrite '%s'.", prefix, name->s_name);
+            array = nullptr;
+            return false;
+        }
+        array = a;
+        return true;
+    }
+
+    // ─────────────────────────────────────
+    // Resize the array, the new words are fetched right away.
+    bool resize(const void *owner, const char *prefix, long n) {
+        if (!get(owner, prefix)) {
+            return false;
+        }
+        garray_resize_long(array, n);
+        array = nullptr;
+        return get(owner, prefix);
+    }
+};
+
+// ╭─────────────────────────────────────╮
+// │  Library-wide redraw scheduler.     │
+// │  Requests are coalesced per array   │
+// │  and flushed at most `rate` times   │
+// │  per second, so the GUI traffic is  │
+// │  bounded however fast objects write │
+// │  to arrays. The rate is set with    │
+// │  [; xlab redrawrate <hz>( and 0     │
+// │  redraws right away.                │
+// ╰─────────────────────────────────────╯
+
+class xlab_redraw {
+  public:
+    // ─────────────────────────────────────
+    static void request(t_symbol *name) {
+        if (rate <= 0) {
+            t_garray *a = (t_garray *)pd_findbyclass(name, garray_class);
+            if (a) {
+                garray_redraw(a);
+            }
+            return;
+        }
+        for (t_symbol *s : pending) {
+            if (s == name) {
+                return;
+            }
+        }
+        pending.push_back(name);
+        if (!scheduled) {
+            if (!clock) {
+                clock = clock_new(nullptr, (t_method)flush);
+            }
+            double wait = 1000.0 / rate - clock_gettimesince(last);
+            clock_delay(clock, wait > 0 ? wait : 0);
+            scheduled = true;
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void request(const xlab_array &arr) {
+        if (arr.name) {
+            request(arr.name);
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void setrate(t_float hz) {
+        rate = hz;
+        if (rate <= 0 && scheduled) {
+            clock_unset(clock);
+            flush(nullptr);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // arrays are looked up again here, so deleted ones are skipped
+    static void flush(void *) {
+        for (t_symbol *s : pending) {
+            t_garray *a = (t_garray *)pd_findbyclass(s, garray_class);
+            if (a) {
+                garray_redraw(a);
+            }
+        }
+        pending.clear();
+        last = clock_getlogicaltime();
+        scheduled = false;
+    }
+
+  private:
+    static inline std::vector<t_symbol *> pending;
+    static inline t_clock *clock = nullptr;
+    static inline t_float rate = 30;
+    static inline double last = 0;
+    static inline bool scheduled = false;
+};
@@ -0,0 +1,872 @@
+#pragma once
+
+#include <m_pd.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define XLAB_DIVERGENCE_INTERVAL 20
+#define XLAB_DIVERGENCE_WORKPAIRS 131072
+
+#include "xlab-array.hpp"
+#include "xlab-simd.hpp"
+#include "xlab-spectrum.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Divergence engine. A measure is a  │
+// │  policy struct with the per-bin     │
+// │  term (exact in double, fast on 4   │
+// │  floats) and the final formula, the │
+// │  template generates the loops and   │
+// │  the three front-ends around it:    │
+// │                                     │
+// │  [kl P Q]    bang, two arrays       │
+// │  [kl]        list, right inlet      │
+// │              stores the reference   │
+// │  [kl] + histogram 128, add 3 1      │
+// │              two count histograms   │
+// │              updated per bin        │
+// │  [kl] + templates t1 t2 t3, match   │
+// │              P against all the      │
+// │              templates, scores and  │
+// │              argmin                 │
+// │  [kl~]       two signals, the left  │
+// │              outlet sends the value │
+// │              every interval ms (20  │
+// │              by default) and/or on  │
+// │              threshold crossings,   │
+// │              the right outlet is a  │
+// │              signal with the value  │
+// │              of each block          │
+// │  [kl~] + window 4096 512            │
+// │              values over the last   │
+// │              4096 samples every 512 │
+// │  [kl~ 2048 512 hann power]          │
+// │              two signals compared   │
+// │              as spectra, see the    │
+// │              spectral message       │
+// │                                     │
+// │  A policy provides:                 │
+// │    name        object name          │
+// │    terms       accumulators used    │
+// │    prescale    true when `norm 1`   │
+// │                can't be folded into │
+// │                result, the inputs   │
+// │                are then scaled by   │
+// │                1/sum in the loop    │
+// │    distribution  silence on one     │
+// │                input outputs 0      │
+// │    alpha       has an alpha method  │
+// │    listrms     list output divided  │
+// │                by sqrt(n), as the   │
+// │                old [euclidean] did  │
+// │    legacyargs  two symbols are      │
+// │                arrays and any other │
+// │                args the signal      │
+// │                form, with or        │
+// │                without ~, as the    │
+// │                old [renyi] did      │
+// │    exact()     one bin, double      │
+// │    fast()      four bins, floats    │
+// │    result()    accumulators to the  │
+// │                output value         │
+// ╰─────────────────────────────────────╯
+
+// ─────────────────────────────────────
+struct xlab_divergence_params {
+    float Alpha;
+    float Beta;
+    bool Normalize;
+    bool Exp;
+    bool Fast;
+};
+
+// ─────────────────────────────────────
+static inline t_float xlab_divergence_value(const t_word &w) { return w.w_float; }
+static inline float xlab_divergence_value(float s) { return s; }
+static inline double xlab_divergence_value(double s) { return s; }
+
+// ─────────────────────────────────────
+template <typename Policy> class xlab_divergence {
+  public:
+    t_object Obj;
+    t_sample Sample;
+    xlab_divergence_params Par;
+
+    bool RealTime;
+    t_clock *Clock;
+    t_outlet *Out;
+    xlab_spectrum *Spectrum;
+    t_canvas *Canvas;
+
+    // message outlet of the ~ objects, every Interval ms and/or on Threshold crossings
+    t_float Interval;
+    int IntervalSamples;
+    int Elapsed;
+    bool UseThreshold;
+    t_float Threshold;
+    bool Above;
+
+    xlab_array P;
+    xlab_array Q;
+    std::vector<t_float> Input;
+    std::vector<t_float> Reference;
+    bool FromList; // see Policy::listrms
+
+    t_float Diversity;
+
+    // time-domain window of the ~ objects, see windowed()
+    int WinSize;
+    int WinHop;
+    int WinWrite;
+    int WinFill;
+    int Segment;
+    std::vector<t_sample> WinP;
+    std::vector<t_sample> WinQ;
+    std::vector<double> Segments;
+
+    // histogram mode, see add()
+    int HistBins;
+    int HistUpdates;
+    std::vector<double> HistP;
+    std::vector<double> HistQ;
+    double HistAcc[Policy::terms + 2];
+
+    // one against many, see match()
+    std::vector<xlab_array> Templates;
+    int TemplateCount;
+    std::vector<const t_word *> TemplateVec;
+    std::vector<t_float> Scores;
+    std::vector<t_atom> ScoreAtoms;
+
+    static inline t_class *Class = nullptr;
+    static inline void (*Construct)(xlab_divergence *) = nullptr;
+
+    // ─────────────────────────────────────
+    // Adds n bins to Acc. Acc[0] and Acc[1] are the sums of the raw inputs, the
+    // policy owns the rest and gets the inputs multiplied by the scales.
+    template <typename T1, typename T2>
+    void accumulate(const T1 *Arr1Vec, const T2 *Arr2Vec, int n, double Scale1, double Scale2,
+                    double *Acc) const {
+        int i = 0;
+        if (Par.Fast) {
+            xlab_vfloat VScale1 = xlab_vdup(Scale1);
+            xlab_vfloat VScale2 = xlab_vdup(Scale2);
+            // float accumulators are flushed into Acc every block
+            while (i + 4 <= n) {
+                xlab_vfloat VAcc[Policy::terms + 2];
+                for (int j = 0; j < Policy::terms + 2; j++) {
+                    VAcc[j] = xlab_vdup(0);
+                }
+                int end = i + 1024 < n ? i + 1024 : n;
+                for (; i + 4 <= end; i += 4) {
+                    xlab_vfloat IVec1 = xlab_vgather(Arr1Vec + i);
+                    xlab_vfloat IVec2 = xlab_vgather(Arr2Vec + i);
+                    VAcc[0] = xlab_vadd(VAcc[0], IVec1);
+                    VAcc[1] = xlab_vadd(VAcc[1], IVec2);
+                    Policy::fast(Par, xlab_vmul(IVec1, VScale1), xlab_vmul(IVec2, VScale2),
+                                 VAcc + 2);
+                }
+                for (int j = 0; j < Policy::terms + 2; j++) {
+                    Acc[j] += xlab_vsum(VAcc[j]);
+                }
+            }
+        }
+        for (; i < n; i++) {
+            double IVec1 = xlab_divergence_value(Arr1Vec[i]);
+            double IVec2 = xlab_divergence_value(Arr2Vec[i]);
+            Acc[0] += IVec1;
+            Acc[1] += IVec2;
+            Policy::exact(Par, IVec1 * Scale1, IVec2 * Scale2, Acc + 2);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // scaled: the policy terms were accumulated on inputs scaled to sum 1. Doesn't
+    // touch the object, the batched match calls it from worker threads.
+    double evaluate(const double *Acc, int n, bool scaled, bool *silent) const {
+        // silence on one of the inputs
+        *silent = Policy::distribution && (Acc[0] == 0 || Acc[1] == 0);
+        if (*silent) {
+            return 0.0;
+        }
+
+        double Div;
+        if (scaled) {
+            Div = Policy::result(Par, Acc + 2, 1.0, 1.0, n);
+        } else {
+            Div = Policy::result(Par, Acc + 2, Acc[0], Acc[1], n);
+        }
+        if (Policy::listrms && FromList && n > 0) {
+            Div /= sqrt((double)n);
+        }
+        if (Par.Exp) {
+            Div = exp(-Par.Beta * Div); // Equation 7.19 in Cont's thesis
+        }
+        return Div;
+    }
+
+    // ─────────────────────────────────────
+    bool finish(const double *Acc, int n, bool scaled) {
+        bool silent;
+        Diversity = evaluate(Acc, n, scaled, &silent);
+        return !silent;
+    }
+
+    // ─────────────────────────────────────
+    template <typename T> bool compute(const T *Arr1Vec, const T *Arr2Vec, int n) {
+        double Scale1 = 1.0;
+        double Scale2 = 1.0;
+        bool scaled = Policy::prescale && Par.Normalize;
+        if (scaled) {
+            double Sum1 = 0.0;
+            double Sum2 = 0.0;
+            for (int i = 0; i < n; i++) {
+                Sum1 += xlab_divergence_value(Arr1Vec[i]);
+                Sum2 += xlab_divergence_value(Arr2Vec[i]);
+            }
+            if (Sum1 == 0 || Sum2 == 0) {
+                Diversity = 0.0;
+                return false;
+            }
+            Scale1 = 1.0 / Sum1;
+            Scale2 = 1.0 / Sum2;
+        }
+
+        double Acc[Policy::terms + 2] = {};
+        accumulate(Arr1Vec, Arr2Vec, n, Scale1, Scale2, Acc);
+        return finish(Acc, n, scaled);
+    }
+
+    // ─────────────────────────────────────
+    // Time-domain window longer than the block. The window is split into
+    // hop-sized segments with their own accumulators, each hop only the newest
+    // segment is computed and the segments are added up, so the cost per hop is
+    // the hop plus one add per segment. With prescaled normalization the
+    // terms depend on the sums of the whole window and are computed again from
+    // the ring buffers. Parameter changes reach the whole window after one
+    // window length.
+    void windowed(const t_sample *Arr1Vec, const t_sample *Arr2Vec, int n) {
+        const int k = Policy::terms + 2;
+        int i = 0;
+        while (i < n) {
+            int chunk = n - i;
+            chunk = chunk < WinHop - WinFill ? chunk : WinHop - WinFill;
+            chunk = chunk < WinSize - WinWrite ? chunk : WinSize - WinWrite;
+            for (int j = 0; j < chunk; j++) {
+                WinP[WinWrite + j] = Arr1Vec[i + j];
+                WinQ[WinWrite + j] = Arr2Vec[i + j];
+            }
+            accumulate(Arr1Vec + i, Arr2Vec + i, chunk, 1.0, 1.0, &Segments[Segment * k]);
+            WinWrite = (WinWrite + chunk) % WinSize;
+            WinFill += chunk;
+            i += chunk;
+            if (WinFill < WinHop) {
+                continue;
+            }
+
+            double Acc[Policy::terms + 2] = {};
+            int count = WinSize / WinHop;
+            for (int s = 0; s < count; s++) {
+                for (int j = 0; j < k; j++) {
+                    Acc[j] += Segments[s * k + j];
+                }
+            }
+            if (!(Policy::prescale && Par.Normalize)) {
+                finish(Acc, WinSize, false);
+            } else if (Acc[0] == 0 || Acc[1] == 0) {
+                Diversity = 0.0;
+            } else {
+                // WinWrite is the oldest sample
+                double Terms[Policy::terms + 2] = {};
+                int first = WinSize - WinWrite;
+                accumulate(WinP.data() + WinWrite, WinQ.data() + WinWrite, first,
+                           1.0 / Acc[0], 1.0 / Acc[1], Terms);
+                accumulate(WinP.data(), WinQ.data(), WinWrite, 1.0 / Acc[0], 1.0 / Acc[1],
+                           Terms);
+                finish(Terms, WinSize, true);
+            }
+
+            WinFill = 0;
+            Segment = (Segment + 1) % count;
+            for (int j = 0; j < k; j++) {
+                Segments[Segment * k + j] = 0;
+            }
+        }
+    }
+
+    // ─────────────────────────────────────
+    // Recomputes the histogram totals from the counts with the exact terms, the
+    // same ones add() uses.
+    void histrefresh() {
+        for (int j = 0; j < Policy::terms + 2; j++) {
+            HistAcc[j] = 0;
+        }
+        for (int i = 0; i < HistBins; i++) {
+            HistAcc[0] += HistP[i];
+            HistAcc[1] += HistQ[i];
+            Policy::exact(Par, HistP[i], HistQ[i], HistAcc + 2);
+        }
+        HistUpdates = 0;
+        if (Policy::prescale && Par.Normalize) {
+            compute(HistP.data(), HistQ.data(), HistBins);
+        } else {
+            finish(HistAcc, HistBins, false);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // histogram <bins>, two internal count histograms updated with add, 0 turns it off
+    static void histogram(xlab_divergence *x, t_floatarg f) {
+        x->HistBins = f > 0 ? f : 0;
+        x->HistP.assign(x->HistBins, 0);
+        x->HistQ.assign(x->HistBins, 0);
+        x->histrefresh();
+    }
+
+    // ─────────────────────────────────────
+    // add <bin> <deltaP> [deltaQ]: only the terms of the changed bin are taken out
+    // and put back, the sums keep the normalization analytic. Measures that scale
+    // their inputs (js and euclidean with norm 1) compute the whole histogram.
+    static void add(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        if (x->HistBins == 0) {
+            pd_error(x, "[%s] add needs a histogram, send histogram <bins> first", Policy::name);
+            return;
+        }
+        int bin = argc > 0 ? atom_getfloat(argv) : -1;
+        if (bin < 0 || bin >= x->HistBins) {
+            pd_error(x, "[%s] bin %d out of range", Policy::name, bin);
+            return;
+        }
+        double p = x->HistP[bin];
+        double q = x->HistQ[bin];
+        double dp = argc > 1 ? atom_getfloat(argv + 1) : 0;
+        double dq = argc > 2 ? atom_getfloat(argv + 2) : 0;
+        x->HistP[bin] = p + dp;
+        x->HistQ[bin] = q + dq;
+
+        if (Policy::prescale && x->Par.Normalize) {
+            x->compute(x->HistP.data(), x->HistQ.data(), x->HistBins);
+            outlet_float(x->Out, x->Diversity);
+            return;
+        }
+
+        double Old[Policy::terms + 2] = {};
+        double New[Policy::terms + 2] = {};
+        Policy::exact(x->Par, p, q, Old + 2);
+        Policy::exact(x->Par, p + dp, q + dq, New + 2);
+        x->HistAcc[0] += dp;
+        x->HistAcc[1] += dq;
+        for (int j = 2; j < Policy::terms + 2; j++) {
+            x->HistAcc[j] += New[j] - Old[j];
+        }
+
+        // the running totals only drift by rounding, refresh them once per histogram
+        if (++x->HistUpdates >= x->HistBins) {
+            x->histrefresh();
+        } else {
+            x->finish(x->HistAcc, x->HistBins, false);
+        }
+        outlet_float(x->Out, x->Diversity);
+    }
+
+    // ─────────────────────────────────────
+    // templates <array1> <array2> ... or templates <array> <count> for count
+    // templates packed one after the other in one array
+    static void templates(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        x->Templates.clear();
+        x->TemplateCount = 0;
+        if (argc == 2 && argv[0].a_type == A_SYMBOL && argv[1].a_type == A_FLOAT) {
+            x->TemplateCount = atom_getfloat(argv + 1);
+            if (x->TemplateCount < 1) {
+                pd_error(x, "[%s] templates count must be at least 1", Policy::name);
+                return;
+            }
+            argc = 1;
+        }
+        for (int i = 0; i < argc; i++) {
+            if (argv[i].a_type != A_SYMBOL) {
+                pd_error(x, "[%s] templates must be array names", Policy::name);
+                x->Templates.clear();
+                return;
+            }
+            xlab_array arr;
+            arr.set(atom_getsymbol(argv + i));
+            x->Templates.push_back(arr);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // word pointers of all templates, each n bins long
+    bool gettemplates(int n) {
+        TemplateVec.clear();
+        if (Templates.empty()) {
+            pd_error(this, "[%s] no templates, send templates first", Policy::name);
+            return false;
+        }
+        if (TemplateCount > 0) {
+            if (!Templates[0].get(this, Policy::name)) {
+                return false;
+            } else if (Templates[0].size != n * TemplateCount) {
+                pd_error(this, "[%s] '%s' must have %d x %d points", Policy::name,
+                         Templates[0].name->s_name, TemplateCount, n);
+                return false;
+            }
+            for (int t = 0; t < TemplateCount; t++) {
+                TemplateVec.push_back(Templates[0].vec + t * n);
+            }
+            return true;
+        }
+        for (xlab_array &arr : Templates) {
+            if (!arr.get(this, Policy::name)) {
+                return false;
+            } else if (arr.size != n) {
+                pd_error(this, "[%s] template '%s' must have %d points", Policy::name,
+                         arr.name->s_name, n);
+                return false;
+            }
+            TemplateVec.push_back(arr.vec);
+        }
+        return true;
+    }
+
+    // ─────────────────────────────────────
+    // Templates first to last against P. P is walked in blocks that stay in cache
+    // while all the templates go through them.
+    template <typename T> void matchrange(const T *Arr1Vec, int n, int first, int last) {
+        const int k = Policy::terms + 2;
+        std::vector<double> Acc((last - first) * k, 0.0);
+        bool scaled = Policy::prescale && Par.Normalize;
+        bool silent;
+        if (scaled) {
+            double Sum1 = 0.0;
+            for (int i = 0; i < n; i++) {
+                Sum1 += xlab_divergence_value(Arr1Vec[i]);
+            }
+            for (int t = first; t < last; t++) {
+                double Sum2 = 0.0;
+                for (int i = 0; i < n; i++) {
+                    Sum2 += TemplateVec[t][i].w_float;
+                }
+                double *acc = &Acc[(t - first) * k];
+                if (Sum1 == 0 || Sum2 == 0) {
+                    Scores[t] = 0.0;
+                    continue;
+                }
+                accumulate(Arr1Vec, TemplateVec[t], n, 1.0 / Sum1, 1.0 / Sum2, acc);
+                Scores[t] = evaluate(acc, n, true, &silent);
+            }
+            return;
+        }
+        for (int i = 0; i < n; i += 1024) {
+            int len = n - i < 1024 ? n - i : 1024;
+            for (int t = first; t < last; t++) {
+                accumulate(Arr1Vec + i, TemplateVec[t] + i, len, 1.0, 1.0, &Acc[(t - first) * k]);
+            }
+        }
+        for (int t = first; t < last; t++) {
+            Scores[t] = evaluate(&Acc[(t - first) * k], n, false, &silent);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // Large batches are split between threads, joined before returning. Each
+    // worker gets at least XLAB_DIVERGENCE_WORKPAIRS value pairs (a few hundred
+    // us), so starting it costs a few percent of its work, and one template.
+    template <typename T> void matchall(const T *Arr1Vec, int n) {
+        int count = TemplateVec.size();
+        Scores.resize(count);
+        long work = (long)count * n / XLAB_DIVERGENCE_WORKPAIRS;
+        int workers = std::thread::hardware_concurrency();
+        workers = work < workers ? work : workers;
+        workers = count < workers ? count : workers;
+        if (workers < 2) {
+            matchrange(Arr1Vec, n, 0, count);
+            return;
+        }
+        std::vector<std::thread> pool;
+        for (int w = 1; w < workers; w++) {
+            pool.emplace_back([this, Arr1Vec, n, count, workers, w] {
+                matchrange(Arr1Vec, n, count * w / workers, count * (w + 1) / workers);
+            });
+        }
+        matchrange(Arr1Vec, n, 0, count / workers);
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+    }
+
+    // ─────────────────────────────────────
+    // match [array|list] compares P (the first array, another array or a list)
+    // with all templates and outputs [scores ...( and [argmin <index> <score>(.
+    // With exp 1 the scores are similarities and argmin is the closest template,
+    // the highest score.
+    static void match(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        int n;
+        if (argc > 0 && argv[0].a_type == A_FLOAT) {
+            n = argc;
+            x->Input.resize(n);
+            for (int i = 0; i < n; i++) {
+                x->Input[i] = atom_getfloat(argv + i);
+            }
+            if (!x->gettemplates(n)) {
+                return;
+            }
+            x->matchall(x->Input.data(), n);
+        } else {
+            xlab_array other;
+            xlab_array *arr = &x->P;
+            if (argc > 0) {
+                other.set(atom_getsymbol(argv));
+                arr = &other;
+            }
+            if (!arr->get(x, Policy::name)) {
+                return;
+            }
+            n = arr->size;
+            if (!x->gettemplates(n)) {
+                return;
+            }
+            x->matchall((const t_word *)arr->vec, n);
+        }
+
+        int count = x->Scores.size();
+        int best = 0;
+        x->ScoreAtoms.resize(count);
+        for (int t = 0; t < count; t++) {
+            SETFLOAT(&x->ScoreAtoms[t], x->Scores[t]);
+            bool better = x->Par.Exp ? x->Scores[t] > x->Scores[best]
+                                     : x->Scores[t] < x->Scores[best];
+            if (better) {
+                best = t;
+            }
+        }
+        t_atom argmin[2];
+        SETFLOAT(argmin, best);
+        SETFLOAT(argmin + 1, count > 0 ? x->Scores[best] : 0);
+        outlet_anything(x->Out, gensym("scores"), count, x->ScoreAtoms.data());
+        outlet_anything(x->Out, gensym("argmin"), 2, argmin);
+    }
+
+    // ─────────────────────────────────────
+    static void bang(xlab_divergence *x) {
+        if (x->RealTime) {
+            outlet_float(x->Out, x->Diversity);
+            return;
+        } else if (x->HistBins > 0) {
+            x->histrefresh();
+            outlet_float(x->Out, x->Diversity);
+            return;
+        } else if (!x->P.name) {
+            // list front-end, the last result
+            outlet_float(x->Out, x->Diversity);
+            return;
+        }
+        if (!x->P.get(x, Policy::name) || !x->Q.get(x, Policy::name)) {
+            return;
+        }
+        if (x->P.size != x->Q.size) {
+            pd_error(x, "[%s] tables must have the same size", Policy::name);
+            return;
+        }
+        x->compute(x->P.vec, x->Q.vec, x->P.size);
+        outlet_float(x->Out, x->Diversity);
+    }
+
+    // ─────────────────────────────────────
+    static void list(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        if ((int)x->Reference.size() != argc) {
+            pd_error(x, "[%s] list must have the same size as the reference", Policy::name);
+            return;
+        }
+        x->Input.resize(argc);
+        for (int i = 0; i < argc; i++) {
+            x->Input[i] = atom_getfloat(argv + i);
+        }
+        x->FromList = true;
+        x->compute(x->Input.data(), x->Reference.data(), argc);
+        x->FromList = false;
+        outlet_float(x->Out, x->Diversity);
+    }
+
+    // ─────────────────────────────────────
+    static void reference(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        x->Reference.resize(argc);
+        for (int i = 0; i < argc; i++) {
+            x->Reference[i] = atom_getfloat(argv + i);
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void set(xlab_divergence *x, t_symbol *p, t_symbol *q) {
+        x->P.set(p);
+        x->Q.set(q);
+    }
+
+    // ─────────────────────────────────────
+    static void norm(xlab_divergence *x, t_floatarg f) { x->Par.Normalize = f == 1; }
+    // ─────────────────────────────────────
+    static void alpha(xlab_divergence *x, t_floatarg f) {
+        x->Par.Alpha = f;
+        if (x->HistBins > 0) {
+            x->histrefresh();
+        }
+    }
+    // ─────────────────────────────────────
+    static void beta(xlab_divergence *x, t_floatarg f) { x->Par.Beta = f; }
+    // ─────────────────────────────────────
+    static void expo(xlab_divergence *x, t_floatarg f) { x->Par.Exp = f; }
+
+    // ─────────────────────────────────────
+    static void precision(xlab_divergence *x, t_symbol *s) {
+        if (s == gensym("fast")) {
+            x->Par.Fast = true;
+        } else if (s == gensym("exact")) {
+            x->Par.Fast = false;
+        } else {
+            pd_error(x, "[%s] precision must be fast or exact", Policy::name);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // window <size> [hop], the size is rounded up to a multiple of the hop and 0
+    // goes back to one value per block
+    static void window(xlab_divergence *x, t_floatarg size, t_floatarg hop) {
+        if (size < 0 || hop < 0) {
+            pd_error(x, "[%s~] window size and hop must be positive", Policy::name);
+            return;
+        }
+        int h = hop > 0 ? hop : size / 2;
+        h = h > 0 ? h : 1;
+        int count = ((int)size + h - 1) / h;
+        x->WinSize = size > 0 ? count * h : 0;
+        x->WinHop = h;
+        x->WinWrite = 0;
+        x->WinFill = 0;
+        x->Segment = 0;
+        x->WinP.assign(x->WinSize, 0);
+        x->WinQ.assign(x->WinSize, 0);
+        x->Segments.assign(size > 0 ? count * (Policy::terms + 2) : 0, 0);
+        if (x->WinSize > 0) {
+            delete x->Spectrum;
+            x->Spectrum = nullptr;
+        }
+    }
+
+    // ─────────────────────────────────────
+    // spectral <size> [hop] [rect|hann|hamming|blackman] [magnitude|power], size 0 goes
+    // back to comparing the raw samples
+    static void spectral(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        int size = 0;
+        int hop = 0;
+        xlab_spectrum::window type = xlab_spectrum::HANN;
+        bool power = false;
+        int floats = 0;
+        for (int i = 0; i < argc; i++) {
+            if (argv[i].a_type == A_FLOAT) {
+                if (floats++ == 0) {
+                    size = atom_getfloat(argv + i);
+                } else {
+                    hop = atom_getfloat(argv + i);
+                }
+                continue;
+            }
+            t_symbol *arg = atom_getsymbol(argv + i);
+            if (arg == gensym("rect")) {
+                type = xlab_spectrum::RECT;
+            } else if (arg == gensym("hann")) {
+                type = xlab_spectrum::HANN;
+            } else if (arg == gensym("hamming")) {
+                type = xlab_spectrum::HAMMING;
+            } else if (arg == gensym("blackman")) {
+                type = xlab_spectrum::BLACKMAN;
+            } else if (arg == gensym("magnitude")) {
+                power = false;
+            } else if (arg == gensym("power")) {
+                power = true;
+            } else {
+                pd_error(x, "[%s~] unknown spectral option '%s'", Policy::name, arg->s_name);
+                return;
+            }
+        }
+        if (size < 0 || size == 1 || hop < 0) {
+            pd_error(x, "[%s~] spectral size and hop must be positive", Policy::name);
+            return;
+        }
+        delete x->Spectrum;
+        x->Spectrum = nullptr;
+        if (size > 0) {
+            x->Spectrum = new xlab_spectrum(size, hop > 0 ? hop : size / 2, type, power);
+            window(x, 0, 0);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // interval <ms>, 0 turns the periodic messages off
+    static void interval(xlab_divergence *x, t_floatarg f) {
+        x->Interval = f > 0 ? f : 0;
+        x->IntervalSamples = x->Interval * sys_getsr() / 1000;
+        x->Elapsed = 0;
+    }
+
+    // ─────────────────────────────────────
+    // threshold <value> outputs when the value crosses it, without args it is off
+    static void threshold(xlab_divergence *x, t_symbol *s, int argc, t_atom *argv) {
+        x->UseThreshold = argc > 0;
+        if (x->UseThreshold) {
+            x->Threshold = atom_getfloat(argv);
+            x->Above = x->Diversity > x->Threshold;
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void tick(xlab_divergence *x) { outlet_float(x->Out, x->Diversity); }
+
+    // ─────────────────────────────────────
+    static t_int *perform(t_int *w) {
+        xlab_divergence *x = (xlab_divergence *)(w[1]);
+        const t_sample *Arr1Vec = (t_sample *)(w[2]);
+        const t_sample *Arr2Vec = (t_sample *)(w[3]);
+        t_sample *OutVec = (t_sample *)(w[4]);
+        int n = (int)(w[5]);
+
+        if (x->WinSize > 0) {
+            x->windowed(Arr1Vec, Arr2Vec, n);
+        } else if (!x->Spectrum) {
+            x->compute(Arr1Vec, Arr2Vec, n);
+        } else if (x->Spectrum->push(Arr1Vec, Arr2Vec, n)) {
+            x->compute(x->Spectrum->MagP, x->Spectrum->MagQ, x->Spectrum->Bins);
+        }
+
+        // OutVec may share memory with the inputs, it is written last
+        t_sample Div = x->Diversity;
+        for (int i = 0; i < n; i++) {
+            OutVec[i] = Div;
+        }
+
+        // the scheduler is only involved when a message is due
+        bool due = false;
+        if (x->IntervalSamples > 0) {
+            x->Elapsed += n;
+            if (x->Elapsed >= x->IntervalSamples) {
+                x->Elapsed -= x->IntervalSamples;
+                due = true;
+            }
+        }
+        if (x->UseThreshold && (Div > x->Threshold) != x->Above) {
+            x->Above = !x->Above;
+            due = true;
+        }
+        if (due) {
+            clock_delay(x->Clock, 0);
+        }
+        return (w + 6);
+    }
+
+    // ─────────────────────────────────────
+    static void dsp(xlab_divergence *x, t_signal **sp) {
+        if (x->RealTime) {
+            x->IntervalSamples = x->Interval * sp[0]->s_sr / 1000;
+            dsp_add(perform, 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_n);
+        }
+    }
+
+    // ─────────────────────────────────────
+    static void *create(t_symbol *s, int argc, t_atom *argv) {
+        xlab_divergence *x = (xlab_divergence *)pd_new(Class);
+        if (Construct) {
+            Construct(x);
+        }
+        x->Canvas = canvas_getcurrent();
+        bool isSinal = s->s_name[strlen(s->s_name) - 1] == '~';
+        if (Policy::legacyargs) {
+            isSinal = argc != 2 || argv[0].a_type != A_SYMBOL || argv[1].a_type != A_SYMBOL;
+        }
+        if (isSinal) {
+            x->RealTime = true;
+            inlet_new(&x->Obj, &x->Obj.ob_pd, &s_signal, &s_signal);
+            x->Clock = clock_new(x, (t_method)tick);
+            interval(x, XLAB_DIVERGENCE_INTERVAL);
+            if (argc > 0) {
+                spectral(x, gensym("spectral"), argc, argv);
+            }
+        } else if (!isSinal && argc == 2) {
+            if (argv[0].a_type != A_SYMBOL || argv[1].a_type != A_SYMBOL) {
+                pd_error(x, "[%s] arg1 and arg2 must be symbols", Policy::name);
+                pd_free(&x->Obj.ob_pd);
+                return nullptr;
+            }
+            x->P.set(atom_getsymbol(argv));
+            x->Q.set(atom_getsymbol(argv + 1));
+        } else if (!isSinal && argc == 0) {
+            inlet_new(&x->Obj, &x->Obj.ob_pd, &s_list, gensym("_reference"));
+        } else {
+            pd_error(x, "[%s] wrong number of args", Policy::name);
+            pd_free(&x->Obj.ob_pd);
+            return nullptr;
+        }
+        // the message outlet stays first, as before the signal outlet was added
+        x->Out = outlet_new(&x->Obj, &s_float);
+        if (x->RealTime) {
+            outlet_new(&x->Obj, &s_signal);
+        }
+        x->Par.Alpha = 1.0;
+        x->Par.Beta = 1.0;
+        return (x);
+    }
+
+    // ─────────────────────────────────────
+    static void destroy(xlab_divergence *x) {
+        if (x->Clock) {
+            clock_free(x->Clock);
+        }
+        delete x->Spectrum;
+        x->Input.~vector();
+        x->Reference.~vector();
+        x->WinP.~vector();
+        x->WinQ.~vector();
+        x->Segments.~vector();
+        x->HistP.~vector();
+        x->HistQ.~vector();
+        x->Templates.~vector();
+        x->TemplateVec.~vector();
+        x->Scores.~vector();
+        x->ScoreAtoms.~vector();
+    }
+
+    // ─────────────────────────────────────
+    // Objects that extend the engine with their own members pass their size, a
+    // free method that ends calling destroy, and a construct function for the
+    // members that can't start as zeroed memory, then add their methods to Class.
+    static void setup(size_t size = sizeof(xlab_divergence), t_method free = (t_method)destroy,
+                      void (*construct)(xlab_divergence *) = nullptr) {
+        Construct = construct;
+        char tilde[MAXPDSTRING];
+        snprintf(tilde, MAXPDSTRING, "%s~", Policy::name);
+        Class = class_new(gensym(Policy::name), (t_newmethod)create, free, size, 0, A_GIMME, 0);
+        class_addcreator((t_newmethod)create, gensym(tilde), A_GIMME, 0);
+        CLASS_MAINSIGNALIN(Class, xlab_divergence, Sample);
+        class_addmethod(Class, (t_method)dsp, gensym("dsp"), A_CANT, 0);
+        class_addbang(Class, (t_method)bang);
+        class_addlist(Class, (t_method)list);
+        class_addmethod(Class, (t_method)reference, gensym("_reference"), A_GIMME, 0);
+        class_addmethod(Class, (t_method)set, gensym("set"), A_SYMBOL, A_SYMBOL, 0);
+        class_addmethod(Class, (t_method)norm, gensym("norm"), A_FLOAT, 0);
+        class_addmethod(Class, (t_method)beta, gensym("beta"), A_FLOAT, 0);
+        class_addmethod(Class, (t_method)expo, gensym("exp"), A_FLOAT, 0);
+        class_addmethod(Class, (t_method)precision, gensym("precision"), A_SYMBOL, 0);
+        class_addmethod(Class, (t_method)spectral, gensym("spectral"), A_GIMME, 0);
+        class_addmethod(Class, (t_method)window, gensym("window"), A_FLOAT, A_DEFFLOAT, 0);
+        class_addmethod(Class, (t_method)histogram, gensym("histogram"), A_FLOAT, 0);
+        class_addmethod(Class, (t_method)add, gensym("add"), A_GIMME, 0);
+        class_addmethod(Class, (t_method)templates, gensym("templates"), A_GIMME, 0);
+        class_addmethod(Class, (t_method)match, gensym("match"), A_GIMME, 0);
+        class_addmethod(Class, (t_method)interval, gensym("interval"), A_FLOAT, 0);
+        class_addmethod(Class, (t_method)threshold, gensym("threshold"), A_GIMME, 0);
+        if (Policy::alpha) {
+            class_addmethod(Class, (t_method)alpha, gensym("alpha"), A_FLOAT, 0);
+        }
+    }
+};
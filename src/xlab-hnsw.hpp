@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <m_pd.h>
+#include <math.h>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+#include "xlab-simd.hpp"
+
+// ╭─────────────────────────────────────╮
+// │  Hierarchical navigable small world │
+// │  graph (Malkov & Yashunin) for      │
+// │  approximate nearest neighbours in  │
+// │  squared euclidean distance.        │
+// │                                     │
+// │  The vectors are not owned, every   │
+// │  call gets the row-major buffer     │
+// │  (rows of Stride floats, Stride a   │
+// │  multiple of 4 and zero padded), so │
+// │  the owner can grow it. Level 0     │
+// │  keeps up to 2*M links per node,    │
+// │  upper levels M. Queries cost about │
+// │  log(n) * ef distance evaluations,  │
+// │  ef trades recall for speed.        │
+// ╰─────────────────────────────────────╯
+
+#define XLAB_HNSW_MAGIC 0x57534e48 // "HNSW"
+#define XLAB_HNSW_VERSION 1
+#define XLAB_HNSW_MAX_M 1024
+
+// ─────────────────────────────────────
+class xlab_hnsw {
+  public:
+    typedef std::pair<float, int> entry;
+
+    int Dim = 0;
+    int Stride = 0;
+    int M = 16;
+    int M0 = 32;
+    int EfConstruction = 200;
+    int Count = 0;
+    int MaxLevel = -1;
+    int Entry = -1;
+
+    // ─────────────────────────────────────
+    void init(int dim, int stride, int m, int efconstruction) {
+        Dim = dim;
+        Stride = stride;
+        M = std::clamp(m, 2, XLAB_HNSW_MAX_M);
+        M0 = 2 * M;
+        EfConstruction = efconstruction > M ? efconstruction : M;
+        Mult = 1 / log((double)M);
+        Count = 0;
+        MaxLevel = -1;
+        Entry = -1;
+        Levels.clear();
+        Links0.clear();
+        Upper.clear();
+    }
+
+    // ─────────────────────────────────────
+    // adds row Count of data
+    void insert(const float *data) {
+        int id = Count++;
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        int level = (int)(-log(1.0 - uniform(Rng)) * Mult);
+        Levels.push_back(level);
+        Links0.resize((size_t)Count * (M0 + 1), 0);
+        Upper.emplace_back((size_t)level * (M + 1), 0);
+        if (Entry < 0) {
+            Entry = id;
+            MaxLevel = level;
+            return;
+        }
+
+        const float *q = row(data, id);
+        int ep = Entry;
+        float d = distance(q, row(data, ep));
+        for (int l = MaxLevel; l > level; l--) {
+            greedy(data, q, l, &ep, &d);
+        }
+        for (int l = std::min(level, MaxLevel); l >= 0; l--) {
+            std::vector<entry> found = layer(data, q, ep, EfConstruction, l);
+            std::sort(found.begin(), found.end());
+            ep = found[0].second;
+            std::vector<entry> chosen = select(data, found, M);
+            int *own = links(id, l);
+            own[0] = chosen.size();
+            for (size_t i = 0; i < chosen.size(); i++) {
+                own[i + 1] = chosen[i].second;
+            }
+            for (const entry &n : chosen) {
+                connect(data, n.second, id, l);
+            }
+        }
+        if (level > MaxLevel) {
+            MaxLevel = level;
+            Entry = id;
+        }
+    }
+
+    // ─────────────────────────────────────
+    // k nearest of query, closest first, distances squared
+    void search(const float *data, const float *query, int k, int ef, std::vector<entry> &out) {
+        out.clear();
+        if (Count == 0) {
+            return;
+        }
+        int ep = Entry;
+        float d = distance(query, row(data, ep));
+        for (int l = MaxLevel; l > 0; l--) {
+            greedy(data, query, l, &ep, &d);
+        }
+        out = layer(data, query, ep, std::max(ef, k), 0);
+        std::sort(out.begin(), out.end());
+        if ((int)out.size() > k) {
+            out.resize(k);
+        }
+    }
+
+    // ─────────────────────────────────────
+    // binary file with the graph and the vectors, native byte order
+    bool save(const char *path, const float *data) const {
+        FILE *f = sys_fopen(path, "wb");
+        if (!f) {
+            return false;
+        }
+        int32_t header[9] = {XLAB_HNSW_MAGIC, XLAB_HNSW_VERSION, Dim, Stride, M, EfConstruction,
+                             Count, MaxLevel, Entry};
+        bool ok = fwrite(header, sizeof(header), 1, f) == 1;
+        ok = ok && fwrite(Levels.data(), sizeof(int), Count, f) == (size_t)Count;
+        ok = ok && fwrite(Links0.data(), sizeof(int), Links0.size(), f) == Links0.size();
+        for (int i = 0; ok && i < Count; i++) {
+            ok = fwrite(Upper[i].data(), sizeof(int), Upper[i].size(), f) == Upper[i].size();
+        }
+        size_t n = (size_t)Count * Stride;
+        ok = ok && fwrite(data, sizeof(float), n, f) == n;
+        sys_fclose(f);
+        return ok;
+    }
+
+    // ─────────────────────────────────────
+    // the whole graph is checked before it is used, a bad file leaves an empty index
+    bool load(const char *path, std::vector<float> &data) {
+        FILE *f = sys_fopen(path, "rb");
+        if (!f) {
+            return false;
+        }
+        int32_t header[9];
+        bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == XLAB_HNSW_MAGIC &&
+                  header[1] == XLAB_HNSW_VERSION && validheader(header, remaining(f));
+        if (ok) {
+            init(header[2], header[3], header[4], header[5]);
+            Count = header[6];
+            MaxLevel = header[7];
+            Entry = header[8];
+            Levels.resize(Count);
+            Links0.resize((size_t)Count * (M0 + 1));
+            ok = fread(Levels.data(), sizeof(int), Count, f) == (size_t)Count;
+            ok = ok && fread(Links0.data(), sizeof(int), Links0.size(), f) == Links0.size();
+            ok = ok && validlevels(remaining(f));
+            if (ok) {
+                Upper.resize(Count);
+            }
+            for (int i = 0; ok && i < Count; i++) {
+                Upper[i].resize((size_t)Levels[i] * (M + 1));
+                ok = fread(Upper[i].data(), sizeof(int), Upper[i].size(), f) == Upper[i].size();
+            }
+            size_t n = (size_t)Count * Stride;
+            ok = ok && validlinks();
+            if (ok) {
+                data.resize(n);
+                ok = fread(data.data(), sizeof(float), n, f) == n;
+            }
+        }
+        sys_fclose(f);
+        if (!ok) {
+            init(0, 0, M, EfConstruction);
+        }
+        return ok;
+    }
+
+  private:
+    double Mult = 1 / log(16.0);
+    std::mt19937 Rng{42};
+    std::vector<int> Levels;
+    std::vector<int> Links0;
+    std::vector<std::vector<int>> Upper;
+    std::vector<unsigned> Visited;
+    unsigned Epoch = 0;
+
+    // ─────────────────────────────────────
+    // bytes left in the file, so sizes from a header are checked before allocating
+    static uint64_t remaining(FILE *f) {
+#ifdef _WIN32
+        int64_t pos = _ftelli64(f);
+        _fseeki64(f, 0, SEEK_END);
+        int64_t end = _ftelli64(f);
+        _fseeki64(f, pos, SEEK_SET);
+#else
+        off_t pos = ftello(f);
+        fseeko(f, 0, SEEK_END);
+        off_t end = ftello(f);
+        fseeko(f, pos, SEEK_SET);
+#endif
+        return pos >= 0 && end >= pos ? (uint64_t)(end - pos) : 0;
+    }
+
+    // ─────────────────────────────────────
+    // the values init would store, and room in the file for the levels, the
+    // level 0 links and the vectors of Count nodes
+    static bool validheader(const int32_t *header, uint64_t bytes) {
+        int dim = header[2], stride = header[3], m = header[4], efc = header[5];
+        int count = header[6], maxlevel = header[7], entry = header[8];
+        if (dim <= 0 || stride != ((int64_t)dim + 3) / 4 * 4 ||
+            m != std::clamp(m, 2, XLAB_HNSW_MAX_M) || efc < m || count < 0) {
+            return false;
+        } else if (count == 0 ? entry != -1 || maxlevel != -1
+                              : entry < 0 || entry >= count || maxlevel < 0) {
+            return false;
+        }
+        uint64_t node = sizeof(int) * (1 + (uint64_t)(2 * m + 1)) + sizeof(float) * stride;
+        return (uint64_t)count <= bytes / node;
+    }
+
+    // ─────────────────────────────────────
+    // levels in 0..MaxLevel with the entry on the top one, and room for the upper links
+    bool validlevels(uint64_t bytes) const {
+        if (Count > 0 && Levels[Entry] != MaxLevel) {
+            return false;
+        }
+        uint64_t upper = 0;
+        for (int level : Levels) {
+            if (level < 0 || level > MaxLevel) {
+                return false;
+            }
+            upper += (uint64_t)level * (M + 1);
+        }
+        return upper <= bytes / sizeof(int);
+    }
+
+    // ─────────────────────────────────────
+    // every list within its size, and every link to a node present on that level
+    bool validlinks() {
+        for (int id = 0; id < Count; id++) {
+            for (int l = 0; l <= Levels[id]; l++) {
+                const int *list = links(id, l);
+                if (list[0] < 0 || list[0] > (l == 0 ? M0 : M)) {
+                    return false;
+                }
+                for (int i = 1; i <= list[0]; i++) {
+                    if (list[i] < 0 || list[i] >= Count || Levels[list[i]] < l) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // ─────────────────────────────────────
+    const float *row(const float *data, int id) const { return data + (size_t)id * Stride; }
+
+    // ─────────────────────────────────────
+    float distance(const float *a, const float *b) const {
+        xlab_vfloat acc = xlab_vdup(0);
+        for (int j = 0; j < Stride; j += 4) {
+            xlab_vfloat d = xlab_vsub(xlab_vload(a + j), xlab_vload(b + j));
+            acc = xlab_vadd(acc, xlab_vmul(d, d));
+        }
+        return xlab_vsum(acc);
+    }
+
+    // ─────────────────────────────────────
+    // links[0] is the count, the ids follow
+    int *links(int id, int level) {
+        if (level == 0) {
+            return &Links0[(size_t)id * (M0 + 1)];
+        }
+        return &Upper[id][(size_t)(level - 1) * (M + 1)];
+    }
+
+    // ─────────────────────────────────────
+    void greedy(const float *data, const float *q, int level, int *ep, float *d) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            int *l = links(*ep, level);
+            for (int i = 1; i <= l[0]; i++) {
+                float dn = distance(q, row(data, l[i]));
+                if (dn < *d) {
+                    *d = dn;
+                    *ep = l[i];
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // ─────────────────────────────────────
+    // best-first search of one level, returns up to ef entries unsorted
+    std::vector<entry> layer(const float *data, const float *q, int ep, int ef, int level) {
+        if (Visited.size() < (size_t)Count) {
+            Visited.resize(Count, 0);
+        }
+        if (++Epoch == 0) {
+            std::fill(Visited.begin(), Visited.end(), 0);
+            Epoch = 1;
+        }
+        // candidates is a min-heap through negated distances, found a max-heap
+        std::vector<entry> candidates;
+        std::vector<entry> found;
+        float d = distance(q, row(data, ep));
+        candidates.push_back({-d, ep});
+        found.push_back({d, ep});
+        Visited[ep] = Epoch;
+        while (!candidates.empty()) {
+            entry c = candidates.front();
+            if (-c.first > found.front().first) {
+                break;
+            }
+            std::pop_heap(candidates.begin(), candidates.end());
+            candidates.pop_back();
+            int *l = links(c.second, level);
+            for (int i = 1; i <= l[0]; i++) {
+                int e = l[i];
+                if (Visited[e] == Epoch) {
+                    continue;
+                }
+                Visited[e] = Epoch;
+                float de = distance(q, row(data, e));
+                if ((int)found.size() < ef || de < found.front().first) {
+                    candidates.push_back({-de, e});
+                    std::push_heap(candidates.begin(), candidates.end());
+                    found.push_back({de, e});
+                    std::push_heap(found.begin(), found.end());
+                    if ((int)found.size() > ef) {
+                        std::pop_heap(found.begin(), found.end());
+                        found.pop_back();
+                    }
+                }
+            }
+        }
+        return found;
+    }
+
+    // ─────────────────────────────────────
+    // neighbour heuristic: a candidate is kept only if it is closer to the new
+    // node than to every neighbour kept so far, which keeps links spread out
+    std::vector<entry> select(const float *data, const std::vector<entry> &sorted, int m) {
+        std::vector<entry> chosen;
+        for (const entry &c : sorted) {
+            if ((int)chosen.size() >= m) {
+                break;
+            }
+            bool good = true;
+            for (const entry &r : chosen) {
+                if (distance(row(data, c.second), row(data, r.second)) < c.first) {
+                    good = false;
+                    break;
+                }
+            }
+            if (good) {
+                chosen.push_back(c);
+            }
+        }
+        return chosen;
+    }
+
+    // ─────────────────────────────────────
+    void connect(const float *data, int node, int id, int level) {
+        int max = level == 0 ? M0 : M;
+        int *l = links(node, level);
+        if (l[0] < max) {
+            l[++l[0]] = id;
+            return;
+        }
+        // full, choose again among the old links and the new one
+        const float *p = row(data, node);
+        std::vector<entry> all;
+        all.push_back({distance(p, row(data, id)), id});
+        for (int i = 1; i <= l[0]; i++) {
+            all.push_back({distance(p, row(data, l[i])), l[i]});
+        }
+        std::sort(all.begin(), all.end());
+        std::vector<entry> chosen = select(data, all, max);
+        l[0] = chosen.size();
+        for (size_t i = 0; i < chosen.size(); i++) {
+            l[i + 1] = chosen[i].second;
+        }
+    }
+};
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <float.h>
+#include <m_pd.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XLAB_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define XLAB_NEON 1
+#endif
+
+// ╭─────────────────────────────────────╮
+// │  4-wide float vectors (SSE2, NEON   │
+// │  or plain arrays) and polynomial    │
+// │  log2/exp2 approximations used by   │
+// │  the `precision fast` mode of the   │
+// │  statistics objects.                │
+// │                                     │
+// │  xlab_log2: x = m * 2^e with m in   │
+// │  [sqrt(1/2), sqrt(2)), log2(m) is a │
+// │  degree 6 polynomial in m - 1.      │
+// │  Max abs error 8e-6 from FLT_MIN    │
+// │  up. Inputs are first raised to     │
+// │  FLT_MIN, so 0, denormals and       │
+// │  negative values all give -126 and  │
+// │  never -inf or NaN: p * log2(p) is  │
+// │  0 for p = 0 without masking.       │
+// │  NaN input is unspecified.          │
+// │                                     │
+// │  xlab_exp2: x = i + f with f in     │
+// │  [-0.5, 0.5], 2^f is a degree 5     │
+// │  polynomial. Max relative error     │
+// │  3e-7, input clamped to             │
+// │  [-126, 127].                       │
+// ╰─────────────────────────────────────╯
+
+#define XLAB_LOG2_C0 1.44270182f
+#define XLAB_LOG2_C1 -0.721208453f
+#define XLAB_LOG2_C2 0.479793876f
+#define XLAB_LOG2_C3 -0.366413265f
+#define XLAB_LOG2_C4 0.318407118f
+#define XLAB_LOG2_C5 -0.206858128f
+
+#define XLAB_EXP2_C0 1.00000012f
+#define XLAB_EXP2_C1 0.693146944f
+#define XLAB_EXP2_C2 0.240221217f
+#define XLAB_EXP2_C3 0.0555074252f
+#define XLAB_EXP2_C4 0.00967545994f
+#define XLAB_EXP2_C5 0.00132669706f
+
+#define XLAB_SQRT2 1.41421356f
+#define XLAB_LN2 0.693147180559945309
+
+// ─────────────────────────────────────
+static inline float xlab_log2(float x) {
+    x = x < FLT_MIN ? FLT_MIN : x;
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int e = (int)(bits >> 23) - 127;
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    if (m > XLAB_SQRT2) {
+        m *= 0.5f;
+        e += 1;
+    }
+    float t = m - 1.0f;
+    float p = XLAB_LOG2_C5;
+    p = p * t + XLAB_LOG2_C4;
+    p = p * t + XLAB_LOG2_C3;
+    p = p * t + XLAB_LOG2_C2;
+    p = p * t + XLAB_LOG2_C1;
+    p = p * t + XLAB_LOG2_C0;
+    return (float)e + t * p;
+}
+
+// ─────────────────────────────────────
+static inline float xlab_exp2(float x) {
+    x = x < -126.0f ? -126.0f : (x > 127.0f ? 127.0f : x);
+    float r = x < 0 ? x - 0.5f : x + 0.5f;
+    int i = (int)r;
+    float f = x - (float)i;
+    float p = XLAB_EXP2_C5;
+    p = p * f + XLAB_EXP2_C4;
+    p = p * f + XLAB_EXP2_C3;
+    p = p * f + XLAB_EXP2_C2;
+    p = p * f + XLAB_EXP2_C1;
+    p = p * f + XLAB_EXP2_C0;
+    uint32_t bits = (uint32_t)(i + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+#if defined(XLAB_SSE2)
+// ─────────────────────────────────────
+typedef __m128 xlab_vfloat;
+
+static inline xlab_vfloat xlab_vdup(float f) { return _mm_set1_ps(f); }
+static inline xlab_vfloat xlab_vload(const float *p) { return _mm_loadu_ps(p); }
+static inline xlab_vfloat xlab_vset(float a, float b, float c, float d) {
+    return _mm_setr_ps(a, b, c, d);
+}
+static inline void xlab_vstore(float *p, xlab_vfloat v) { _mm_storeu_ps(p, v); }
+static inline xlab_vfloat xlab_vadd(xlab_vfloat a, xlab_vfloat b) { return _mm_add_ps(a, b); }
+static inline xlab_vfloat xlab_vsub(xlab_vfloat a, xlab_vfloat b) { return _mm_sub_ps(a, b); }
+static inline xlab_vfloat xlab_vmul(xlab_vfloat a, xlab_vfloat b) { return _mm_mul_ps(a, b); }
+static inline xlab_vfloat xlab_vdiv(xlab_vfloat a, xlab_vfloat b) { return _mm_div_ps(a, b); }
+static inline xlab_vfloat xlab_vmin(xlab_vfloat a, xlab_vfloat b) { return _mm_min_ps(a, b); }
+static inline xlab_vfloat xlab_vmax(xlab_vfloat a, xlab_vfloat b) { return _mm_max_ps(a, b); }
+static inline xlab_vfloat xlab_vsqrt(xlab_vfloat a) { return _mm_sqrt_ps(a); }
+static inline xlab_vfloat xlab_vabs(xlab_vfloat a) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+
+// lanes where both p and q are positive keep v, the others become 0
+static inline xlab_vfloat xlab_vkeep_positive(xlab_vfloat v, xlab_vfloat p, xlab_vfloat q) {
+    __m128 zero = _mm_setzero_ps();
+    return _mm_and_ps(v, _mm_and_ps(_mm_cmpgt_ps(p, zero), _mm_cmpgt_ps(q, zero)));
+}
+
+static inline float xlab_vsum(xlab_vfloat v) {
+    __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// ─────────────────────────────────────
+static inline xlab_vfloat xlab_vlog2(xlab_vfloat x) {
+    x = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+    __m128i bits = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+                        _mm_set1_epi32(0x3f800000));
+    __m128 m = _mm_castsi128_ps(bits);
+    __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(XLAB_SQRT2));
+    m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+    e = _mm_sub_epi32(e, _mm_castps_si128(big));
+    __m128 t = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+    __m128 p = _mm_set1_ps(XLAB_LOG2_C5);
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(XLAB_LOG2_C4));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(XLAB_LOG2_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(XLAB_LOG2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(XLAB_LOG2_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(XLAB_LOG2_C0));
+    return _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(t, p));
+}
+
+// ─────────────────────────────────────
+static inline xlab_vfloat xlab_vexp2(xlab_vfloat x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+    __m128i i = _mm_cvtps_epi32(x);
+    __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+    __m128 p = _mm_set1_ps(XLAB_EXP2_C5);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(XLAB_EXP2_C4));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(XLAB_EXP2_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(XLAB_EXP2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(XLAB_EXP2_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(XLAB_EXP2_C0));
+    __m128i scale = _mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+#elif defined(XLAB_NEON)
+// ─────────────────────────────────────
+typedef float32x4_t xlab_vfloat;
+
+static inline xlab_vfloat xlab_vdup(float f) { return vdupq_n_f32(f); }
+static inline xlab_vfloat xlab_vload(const float *p) { return vld1q_f32(p); }
+static inline xlab_vfloat xlab_vset(float a, float b, float c, float d) {
+    float f[4] = {a, b, c, d};
+    return vld1q_f32(f);
+}
+static inline void xlab_vstore(float *p, xlab_vfloat v) { vst1q_f32(p, v); }
+static inline xlab_vfloat xlab_vadd(xlab_vfloat a, xlab_vfloat b) { return vaddq_f32(a, b); }
+static inline xlab_vfloat xlab_vsub(xlab_vfloat a, xlab_vfloat b) { return vsubq_f32(a, b); }
+static inline xlab_vfloat xlab_vmul(xlab_vfloat a, xlab_vfloat b) { return vmulq_f32(a, b); }
+static inline xlab_vfloat xlab_vdiv(xlab_vfloat a, xlab_vfloat b) { return vdivq_f32(a, b); }
+static inline xlab_vfloat xlab_vmin(xlab_vfloat a, xlab_vfloat b) { return vminq_f32(a, b); }
+static inline xlab_vfloat xlab_vmax(xlab_vfloat a, xlab_vfloat b) { return vmaxq_f32(a, b); }
+static inline xlab_vfloat xlab_vsqrt(xlab_vfloat a) { return vsqrtq_f32(a); }
+static inline xlab_vfloat xlab_vabs(xlab_vfloat a) { return vabsq_f32(a); }
+
+static inline xlab_vfloat xlab_vkeep_positive(xlab_vfloat v, xlab_vfloat p, xlab_vfloat q) {
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    uint32x4_t mask = vandq_u32(vcgtq_f32(p, zero), vcgtq_f32(q, zero));
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), mask));
+}
+
+static inline float xlab_vsum(xlab_vfloat v) { return vaddvq_f32(v); }
+
+// ─────────────────────────────────────
+static inline xlab_vfloat xlab_vlog2(xlab_vfloat x) {
+    x = vmaxq_f32(x, vdupq_n_f32(FLT_MIN));
+    uint32x4_t bits = vreinterpretq_u32_f32(x);
+    int32x4_t e = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127));
+    bits = vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000));
+    float32x4_t m = vreinterpretq_f32_u32(bits);
+    uint32x4_t big = vcgtq_f32(m, vdupq_n_f32(XLAB_SQRT2));
+    m = vbslq_f32(big, vmulq_f32(m, vdupq_n_f32(0.5f)), m);
+    e = vsubq_s32(e, vreinterpretq_s32_u32(big));
+    float32x4_t t = vsubq_f32(m, vdupq_n_f32(1.0f));
+    float32x4_t p = vdupq_n_f32(XLAB_LOG2_C5);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_LOG2_C4), p, t);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_LOG2_C3), p, t);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_LOG2_C2), p, t);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_LOG2_C1), p, t);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_LOG2_C0), p, t);
+    return vfmaq_f32(vcvtq_f32_s32(e), t, p);
+}
+
+// ─────────────────────────────────────
+static inline xlab_vfloat xlab_vexp2(xlab_vfloat x) {
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-126.0f)), vdupq_n_f32(127.0f));
+    int32x4_t i = vcvtnq_s32_f32(x);
+    float32x4_t f = vsubq_f32(x, vcvtq_f32_s32(i));
+    float32x4_t p = vdupq_n_f32(XLAB_EXP2_C5);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_EXP2_C4), p, f);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_EXP2_C3), p, f);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_EXP2_C2), p, f);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_EXP2_C1), p, f);
+    p = vfmaq_f32(vdupq_n_f32(XLAB_EXP2_C0), p, f);
+    int32x4_t scale = vshlq_n_s32(vaddq_s32(i, vdupq_n_s32(127)), 23);
+    return vmulq_f32(p, vreinterpretq_f32_s32(scale));
+}
+
+#else
+// ─────────────────────────────────────
+// plain arrays, the compiler may still vectorize the loops
+struct xlab_vfloat {
+    float v[4];
+};
+
+static inline xlab_vfloat xlab_vdup(float f) { return {{f, f, f, f}}; }
+static inline xlab_vfloat xlab_vload(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+static inline xlab_vfloat xlab_vset(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+static inline void xlab_vstore(float *p, xlab_vfloat v) { memcpy(p, v.v, sizeof(v.v)); }
+
+#define XLAB_VOP(name, expr)                                                                       \
+    static inline xlab_vfloat name(xlab_vfloat a, xlab_vfloat b) {                                 \
+        xlab_vfloat r;                                                                             \
+        for (int i = 0; i < 4; i++) {                                                              \
+            r.v[i] = expr;                                                                         \
+        }                                                                                          \
+        return r;                                                                                  \
+    }
+XLAB_VOP(xlab_vadd, a.v[i] + b.v[i])
+XLAB_VOP(xlab_vsub, a.v[i] - b.v[i])
+XLAB_VOP(xlab_vmul, a.v[i] * b.v[i])
+XLAB_VOP(xlab_vdiv, a.v[i] / b.v[i])
+XLAB_VOP(xlab_vmin, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+XLAB_VOP(xlab_vmax, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+#undef XLAB_VOP
+
+static inline xlab_vfloat xlab_vsqrt(xlab_vfloat a) {
+    for (int i = 0; i < 4; i++) {
+        a.v[i] = sqrtf(a.v[i]);
+    }
+    return a;
+}
+static inline xlab_vfloat xlab_vabs(xlab_vfloat a) {
+    for (int i = 0; i < 4; i++) {
+        a.v[i] = fabsf(a.v[i]);
+    }
+    return a;
+}
+static inline xlab_vfloat xlab_vkeep_positive(xlab_vfloat v, xlab_vfloat p, xlab_vfloat q) {
+    for (int i = 0; i < 4; i++) {
+        v.v[i] = (p.v[i] > 0 && q.v[i] > 0) ? v.v[i] : 0.0f;
+    }
+    return v;
+}
+static inline float xlab_vsum(xlab_vfloat v) { return v.v[0] + v.v[1] + v.v[2] + v.v[3]; }
+static inline xlab_vfloat xlab_vlog2(xlab_vfloat x) {
+    for (int i = 0; i < 4; i++) {
+        x.v[i] = xlab_log2(x.v[i]);
+    }
+    return x;
+}
+static inline xlab_vfloat xlab_vexp2(xlab_vfloat x) {
+    for (int i = 0; i < 4; i++) {
+        x.v[i] = xlab_exp2(x.v[i]);
+    }
+    return x;
+}
+#endif
+
+// ─────────────────────────────────────
+// load 4 values from signal vectors (float or double) or from t_word arrays
+static inline xlab_vfloat xlab_vgather(const float *p) { return xlab_vload(p); }
+static inline xlab_vfloat xlab_vgather(const double *p) {
+    return xlab_vset((float)p[0], (float)p[1], (float)p[2], (float)p[3]);
+}
+static inline xlab_vfloat xlab_vgather(const t_word *p) {
+    return xlab_vset((float)p[0].w_float, (float)p[1].w_float, (float)p[2].w_float,
+                     (float)p[3].w_float);
+}
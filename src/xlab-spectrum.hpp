@@ -0,0 +1,153 @@
+#pragma once
+
+#include <fftw3.h>
+#include <m_pd.h>
+#include <math.h>
+#include <vector>
+
+// ╭─────────────────────────────────────╮
+// │  Short-time spectrum of one or two  │
+// │  signals for the spectral modes of  │
+// │  the statistics objects. The inputs │
+// │  are buffered, windowed and         │
+// │  transformed every hop samples into │
+// │  magnitude or power spectra. The    │
+// │  real-to-complex plans are cached   │
+// │  per size and shared by all the     │
+// │  objects, fftwf buffers keep the    │
+// │  alignment the plans were made for. │
+// ╰─────────────────────────────────────╯
+
+// ─────────────────────────────────────
+class xlab_spectrum {
+  public:
+    enum window { RECT, HANN, HAMMING, BLACKMAN };
+
+    int Size;
+    int Hop;
+    int Bins;
+    bool Power;
+
+    float *MagP;
+    float *MagQ;
+
+    // ─────────────────────────────────────
+    xlab_spectrum(int size, int hop, window type, bool power)
+        : Size(size), Hop(hop), Bins(size / 2 + 1), Power(power) {
+        BufP.assign(Size, 0);
+        BufQ.assign(Size, 0);
+        Window.resize(Size);
+        for (int i = 0; i < Size; i++) {
+            double phase = 2 * M_PI * i / Size;
+            switch (type) {
+            case HANN:
+                Window[i] = 0.5 - 0.5 * cos(phase);
+                break;
+            case HAMMING:
+                Window[i] = 0.54 - 0.46 * cos(phase);
+                break;
+            case BLACKMAN:
+                Window[i] = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2 * phase);
+                break;
+            default:
+                Window[i] = 1;
+            }
+        }
+        In = fftwf_alloc_real(Size);
+        Out = fftwf_alloc_complex(Bins);
+        MagP = fftwf_alloc_real(Bins);
+        MagQ = fftwf_alloc_real(Bins);
+        Plan = plan(Size);
+        Write = 0;
+        Countdown = Hop;
+    }
+
+    // ─────────────────────────────────────
+    ~xlab_spectrum() {
+        fftwf_free(In);
+        fftwf_free(Out);
+        fftwf_free(MagP);
+        fftwf_free(MagQ);
+    }
+
+    // ─────────────────────────────────────
+    // Feed one block of both signals, q may be null to analyze only p. When at
+    // least one hop has elapsed the latest Size samples are analyzed, once per
+    // block, and true is returned.
+    bool push(const t_sample *p, const t_sample *q, int n) {
+        // blocks longer than the window only keep their tail
+        int skip = n > Size ? n - Size : 0;
+        for (int i = skip; i < n;) {
+            int chunk = n - i < Size - Write ? n - i : Size - Write;
+            for (int j = 0; j < chunk; j++) {
+                BufP[Write + j] = p[i + j];
+            }
+            for (int j = 0; q && j < chunk; j++) {
+                BufQ[Write + j] = q[i + j];
+            }
+            Write = (Write + chunk) % Size;
+            i += chunk;
+        }
+        Countdown -= n;
+        if (Countdown > 0) {
+            return false;
+        }
+        while (Countdown <= 0) {
+            Countdown += Hop;
+        }
+        analyze(BufP, MagP);
+        if (q) {
+            analyze(BufQ, MagQ);
+        }
+        return true;
+    }
+
+    // ─────────────────────────────────────
+    // complex spectrum of the last analysis (of q when it was given)
+    const fftwf_complex *complex() const { return Out; }
+
+  private:
+    std::vector<float> BufP;
+    std::vector<float> BufQ;
+    std::vector<float> Window;
+    float *In;
+    fftwf_complex *Out;
+    fftwf_plan Plan;
+    int Write;
+    int Countdown;
+
+    // ─────────────────────────────────────
+    void analyze(const std::vector<float> &buf, float *mag) {
+        // unroll the ring buffer, oldest sample first
+        int first = Size - Write;
+        for (int i = 0; i < first; i++) {
+            In[i] = buf[Write + i] * Window[i];
+        }
+        for (int i = first; i < Size; i++) {
+            In[i] = buf[i - first] * Window[i];
+        }
+        fftwf_execute_dft_r2c(Plan, In, Out);
+        for (int k = 0; k < Bins; k++) {
+            float power = Out[k][0] * Out[k][0] + Out[k][1] * Out[k][1];
+            mag[k] = Power ? power : sqrtf(power);
+        }
+    }
+
+    // ─────────────────────────────────────
+    static fftwf_plan plan(int size) {
+        for (auto &cached : Plans) {
+            if (cached.first == size) {
+                return cached.second;
+            }
+        }
+        float *in = fftwf_alloc_real(size);
+        fftwf_complex *out = fftwf_alloc_complex(size / 2 + 1);
+        fftwf_plan p = fftwf_plan_dft_r2c_1d(size, in, out, FFTW_ESTIMATE);
+        fftwf_free(in);
+        fftwf_free(out);
+        Plans.push_back({size, p});
+        return p;
+    }
+
+    static inline std::vector<std::pair<int, fftwf_plan>> Plans;
+};
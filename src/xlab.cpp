@@ -1,4 +1,5 @@
 #include "xlab.hpp"
+#include "xlab-array.hpp"
 #include <string>
 
 extern "C" {
@@ -6,6 +7,7 @@ extern "C" {
 }
 
 static t_class *xlabLib;
+static t_class *xlabSettings;
 
 // ==============================================
 static void *xlab_new(void) {
@@ -13,6 +15,9 @@ static void *xlab_new(void) {
     return (x);
 }
 
+// ==============================================
+static void xlab_redrawrate(t_pd *x, t_floatarg f) { xlab_redraw::setrate(f); }
+
 // ==============================================
 extern "C" void xlab_setup(void) {
     int major, minor, micro;
@@ -71,16 +76,31 @@ extern "C" void xlab_setup(void) {
     arrayrotate_setup();
     arraysum_setup();
     arrayappend_setup();
+    arraywindow_setup();
+    arrayinvert_setup();
 
     // statistics
     kldivergence_setup();
     renyi_setup();
     euclidean_setup();
+    jensenshannon_setup();
+    hellinger_setup();
+    bhattacharyya_setup();
+    itakurasaito_setup();
     entropy_setup();
+    dtw_setup();
     kalman_setup();
 
+    // mir
+    nonset_tilde_setup();
+
     // utils
     infinite0x2erecord_tilde_setup();
 
+    // library settings, [; xlab redrawrate 30(
+    xlabSettings = class_new(gensym("xlab-settings"), 0, 0, sizeof(t_pd), CLASS_PD, A_NULL);
+    class_addmethod(xlabSettings, (t_method)xlab_redrawrate, gensym("redrawrate"), A_FLOAT, 0);
+    pd_bind(pd_new(xlabSettings), gensym("xlab"));
+
     post("[pd-xlab] version %d.%d.%d", 0, 1, 0);
 }
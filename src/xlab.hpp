@@ -5,13 +5,22 @@
 void arrayrotate_setup(void);
 void arraysum_setup(void);
 void arrayappend_setup(void);
+void arraywindow_setup(void);
+void arrayinvert_setup(void);
 
 void kldivergence_setup(void);
 void renyi_setup(void);
 void euclidean_setup(void);
+void jensenshannon_setup(void);
+void hellinger_setup(void);
+void bhattacharyya_setup(void);
+void itakurasaito_setup(void);
 void entropy_setup(void);
+void dtw_setup(void);
 void kalman_setup(void);
 
+void nonset_tilde_setup(void);
+
 // ╭─────────────────────────────────────╮
 // │                UTILS                │
 // ╰─────────────────────────────────────╯